@@ -0,0 +1,71 @@
+#ifndef CLOCK_MANAGER_H
+#define CLOCK_MANAGER_H
+
+#include <Arduino.h>
+
+/**
+ * CPU clock prescaler (CLKPR) for the low demand phases: with the screen off, the loop only
+ * samples the sensors and checks the schedule, which doesn't need the full clock.
+ * What derives from the CPU clock is kept right: millis() through clockMillis(), the UART
+ * baud rate and the ADC clock through a table computed at compile time from F_CPU.
+ * The timing critical parts (DHT bit banging, I2C, pump PWM) only run at full speed.
+ */
+// Divide by 2^CLOCK_SLOW_SHIFT: 8MHz on the Nano, 4MHz on the isp board
+#define CLOCK_SLOW_SHIFT 1
+// Fastest ADC clock for the full 10 bits
+#define CLOCK_ADC_MAX_HZ 200000ul
+
+/**
+ * Registers depending on the CPU clock, see clockTiming().
+ */
+struct ClockTiming
+{
+  uint16_t ubrr;        // UBRR0, with U2X0 set as HardwareSerial does
+  uint8_t adcPrescaler; // ADPS bits of ADCSRA
+};
+
+constexpr uint32_t clockHz(uint8_t shift)
+{
+  return F_CPU >> shift;
+}
+
+constexpr uint8_t clockAdcPrescaler(uint32_t hz, uint8_t adps = 1)
+{
+  return adps >= 7 || (hz >> adps) <= CLOCK_ADC_MAX_HZ ? adps : clockAdcPrescaler(hz, adps + 1);
+}
+
+constexpr ClockTiming clockTiming(uint8_t shift, uint32_t baud)
+{
+  return ClockTiming{(uint16_t)((clockHz(shift) / 4 / baud - 1) / 2), clockAdcPrescaler(clockHz(shift))};
+}
+
+struct ClockManager
+{
+  const ClockTiming* timings; // Full speed, then slowed down
+  bool slow;
+  uint32_t rawMs;  // millis() at the last change
+  uint32_t baseMs; // clockMillis() at the last change
+};
+
+/**
+ * At the start of setup(). timings[0] is for the full clock, timings[1] for the slow one.
+ */
+void clockBegin(ClockManager* clock, const ClockTiming* timings);
+
+/**
+ * Carry on counting from uptimeMs, after a warm restart.
+ */
+void clockResume(ClockManager* clock, uint32_t uptimeMs);
+
+/**
+ * Change the clock, the UART and the ADC. The caller makes sure nothing is being clocked
+ * out at the time (e.g. Serial.flush()).
+ */
+void clockSetSlow(ClockManager* clock, bool slow);
+
+/**
+ * millis() in real ms, whatever the clock was. Its resolution is 2^CLOCK_SLOW_SHIFT ms while slow.
+ */
+uint32_t clockMillis(const ClockManager* clock);
+
+#endif /* CLOCK_MANAGER_H */
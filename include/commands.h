@@ -0,0 +1,70 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+
+#include "pump.h"
+#include "sensor_config.h"
+#include "sensor_data.h"
+
+/**
+ * Commands received on the telemetry link, see telemetry.h for the protocol.
+ *
+ * The application owns the pumps and the sensors: it provides the state and the
+ * functions declared below (main.cpp on the board, the test on the host).
+ */
+
+/**
+ * Handle a command frame and send its reply. now is the uptime reported by GET_STATE.
+ */
+void handleCommand(uint32_t now, uint8_t type, const uint8_t *payload, uint8_t len);
+
+// Provided by the application
+extern Pump pumps[NUM_PUMPS];
+extern SensorConfig sensorConfig;
+extern SensorData sensorData;
+
+/**
+ * Queue a pump on the arbiter, it starts when the power budget allows.
+ */
+void requestPump(uint8_t pumpIdx);
+void stopPump(uint8_t pumpIdx);
+uint8_t pumpsRunningMask();
+/**
+ * The latched fault, and its acknowledgement (false while its cause is still there).
+ */
+bool faultActive();
+bool acknowledgeFault();
+/**
+ * Flow meter calibration from the ml measured for the last run of a pump.
+ * Returns the new ul per pulse, 0 if it can't be set.
+ */
+uint16_t calibrateFlow(uint8_t pumpIdx, uint16_t ml);
+/**
+ * Raw ADC value of the soil probe of a pump, or of the light sensor, for the calibration.
+ */
+int readSoilSensorRaw(uint8_t pumpIdx);
+int readLightSensorRaw();
+/**
+ * Appended to GET_STATE: the reset flags (MCUSR) and whether the runtime state was resumed.
+ * Returns the bytes written, 0 in a build without warm restart.
+ */
+uint8_t bootState(uint8_t *state);
+/**
+ * Apply a sensor config from the host: the probes with new dry/wet values go back to that line.
+ */
+void setSensorConfig(SensorConfig config);
+/**
+ * Save the running config, with which probes use their soil curve.
+ */
+void saveConfig();
+/**
+ * Soil curves, see soil_curve.h: the one a probe uses now (its dry/wet line without a curve of
+ * its own), a validated one from the host, saved right away, and back to the line after a
+ * dry/wet calibration.
+ */
+void soilCurve(uint8_t pumpIdx, uint8_t *knots);
+void setSoilCurve(uint8_t pumpIdx, const uint8_t *knots);
+void resetSoilCurve(uint8_t pumpIdx);
+
+#endif /* COMMANDS_H */
@@ -3,18 +3,66 @@
 
 #include <Arduino.h>
 #include <EEPROMex.h>
+#include <stddef.h>
 
+#include "dose_log.h"
+#include "eeprom_mem.h"
+#include "fault_log.h"
+#include "history.h"
 #include "pump.h"
 #include "sensor_config.h"
+#include "soil_curve.h"
 
-struct EEPROM_MEM {
-  PumpConfig pumpConfigs[3];
+// The config lives at the start of the EEPROM, the other blocks after it
+#define EEPROM_HISTORY_ADDR 512
+#define EEPROM_FAULTS_ADDR 704
+#define EEPROM_CURVES_ADDR 768
+#define EEPROM_DOSES_ADDR 896 // 10 records of 10 bytes (12 on the host), to the end
+
+/**
+ * Image written before the layout was versioned: no header, and PumpConfig without the dosing fields.
+ */
+struct PumpConfigV0 {
+  int16_t frequency;
+  int16_t secondsPump;
+  int16_t power;
+  uint8_t soilSensor;
+  uint8_t lightSensor;
+};
+
+struct EEPROM_MEM_V0 {
+  PumpConfigV0 pumpConfigs[3];
+  SensorConfig sensorConfig;
+};
+
+/**
+ * Version 1: PumpConfig without the flow meter fields.
+ */
+struct PumpConfigV1 {
+  int16_t frequency;
+  int16_t secondsPump;
+  int16_t power;
+  uint8_t soilSensor;
+  uint8_t lightSensor;
+  uint8_t mode;
+  uint8_t doseGain;
+};
+
+struct EEPROM_MEM_V1 {
+  uint8_t magic;
+  uint8_t version;
+  PumpConfigV1 pumpConfigs[3];
   SensorConfig sensorConfig;
 };
 
+// Config image written by the host, until it's committed (the config itself is at 0)
+#define EEPROM_STAGED_ADDR 256
+
 /**
  * Load all Pumps Config from the EEPROM to the memory.
  * If the Pump was already initialized, just loads the config;
+ * An image of an older layout is converted first (the new fields take their defaults),
+ * a blank EEPROM is reset to the defaults.
  */
 void loadEEPROM(Pump* pumps, uint8_t pumpsCount, SensorConfig* sensorConfig);
 
@@ -23,6 +71,79 @@ void loadEEPROM(Pump* pumps, uint8_t pumpsCount, SensorConfig* sensorConfig);
  */
 void saveEEPROM(Pump* pumps, uint8_t pumpsCount, SensorConfig sensorConfig);
 
+/**
+ * Save only the learned gain of a pump, leaving the rest of its config as it is in the EEPROM.
+ */
+void saveDoseGain(uint8_t pumpIdx, uint8_t doseGain);
+
+/**
+ * Check that the image is of this layout version, and that every value of the config is in the
+ * MIN/MAX range and a multiple of its STEP, i.e. that loadEEPROM() would keep it as is.
+ */
+bool validateConfig(EEPROM_MEM mem, uint8_t pumpsCount);
+
+/**
+ * Copy the in memory configuration into an EEPROM_MEM image.
+ */
+EEPROM_MEM currentConfig(Pump* pumps, uint8_t pumpsCount, SensorConfig sensorConfig);
+
+/**
+ * Load the sensor history saved by saveHistory(). Starts a new one if there is nothing valid.
+ */
+void loadHistory(History* history);
+
+/**
+ * Save the sensor history. Only the changed bytes are written.
+ */
+void saveHistory(const History* history);
+
+/**
+ * Load the fault log, empty if there is nothing valid.
+ */
+void loadFaultLog(FaultLog* log);
+
+/**
+ * Check the soil curves in the EEPROM. Returns the probes with a valid curve of their own (bit i
+ * for probe i), the others use the line between their dry and wet values.
+ */
+uint8_t loadSoilCurves();
+
+/**
+ * Save which probes use their curve, e.g. after recalibrating the dry/wet values of some.
+ */
+void saveSoilCurvesCustom(uint8_t custom);
+
+/**
+ * The curve of a probe, SOIL_CURVE_KNOTS bytes.
+ */
+void readSoilCurve(uint8_t probe, uint8_t* knots);
+
+/**
+ * Save the curve of a probe, and use it from now on. Only the changed bytes are written.
+ */
+void saveSoilCurve(uint8_t probe, const uint8_t* knots);
+
+/**
+ * Moisture in % for a raw reading of the probe, from the two knots around it in the EEPROM.
+ */
+uint8_t evalSoilCurve(uint8_t probe, uint16_t raw);
+
+/**
+ * Append a fault to the log in the EEPROM, overwriting the oldest one when full.
+ */
+void logFault(uint8_t code, uint32_t uptimeMs, uint8_t pumpsRunning);
+
+/**
+ * Record a pump run in the dose log, in place of the oldest one when full.
+ */
+void logDose(uint8_t pumpIdx, uint32_t uptimeMs, uint16_t seconds, uint16_t ml);
+
+/**
+ * Read run idx of the dose log, 0 being the oldest. Returns the number of runs logged,
+ * record is only filled if idx is below it.
+ */
+uint8_t loadDose(uint8_t idx, DoseRecord* record);
+
 #define ALPHA 30
 #define ALPHA_SCALE 100
 
@@ -0,0 +1,45 @@
+#ifndef DISPLAY_POWER_H
+#define DISPLAY_POWER_H
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+
+/**
+ * Power states of the SSD1306, driven by its own commands: a few bytes on the I2C instead
+ * of pushing a blank frame. The controller keeps its RAM while off, so waking up shows
+ * the last frame right away.
+ */
+// Dim the screen after this long without a button press (the screen is off after SLEEP_TIME)
+#define DISPLAY_DIM_MS 8000ul
+#define DISPLAY_CONTRAST_NORMAL 0xCF // What begin() sets with SSD1306_SWITCHCAPVCC
+#define DISPLAY_CONTRAST_DIM 0x01
+
+enum DisplayPower
+{
+  DISPLAY_ON,
+  DISPLAY_DIMMED,
+  DISPLAY_OFF
+};
+
+struct DisplayPowerManager
+{
+  Adafruit_SSD1306* display;
+  DisplayPower state;
+};
+
+/**
+ * After display.begin(), which leaves the screen on.
+ */
+void displayPowerBegin(DisplayPowerManager* manager, Adafruit_SSD1306* display);
+
+/**
+ * Turn the screen on (or back to full contrast), dimmed once idleMs reaches DISPLAY_DIM_MS.
+ */
+void displayPowerUpdate(DisplayPowerManager* manager, uint32_t idleMs);
+
+/**
+ * Screen and charge pump off, the RAM is kept.
+ */
+void displayPowerOff(DisplayPowerManager* manager);
+
+#endif /* DISPLAY_POWER_H */
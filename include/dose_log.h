@@ -0,0 +1,24 @@
+#ifndef DOSE_LOG_H
+#define DOSE_LOG_H
+
+#include <stdint.h>
+
+/**
+ * Water delivered by the last runs, one record written when a pump stops.
+ * There is no header to rewrite on every run: the slots are filled in turn and the
+ * sequence numbers tell where the ring goes on, so each cell is only written once per
+ * DOSE_LOG_SIZE runs.
+ */
+#define DOSE_LOG_SIZE 10
+#define DOSE_EMPTY 0xFF // pump of a slot never written
+
+struct DoseRecord
+{
+  uint32_t uptimeMs; // When the pump stopped
+  uint16_t seconds;  // How long it ran
+  uint16_t ml;       // Measured by its flow meter, 0 without one
+  uint8_t pump;      // DOSE_EMPTY for a free slot
+  uint8_t seq;       // One more than the record before it, wrapping
+};
+
+#endif /* DOSE_LOG_H */
@@ -0,0 +1,22 @@
+#ifndef EEPROM_MEM_H
+#define EEPROM_MEM_H
+
+#include <Arduino.h>
+
+#include "pump_config.h"
+#include "sensor_config.h"
+
+// Marks an image written by this firmware, and the layout it was written with
+#define EEPROM_MEM_MAGIC 0x5A
+// 1: magic and version, PumpConfig.mode and doseGain for the adaptive dosing
+// 2: PumpConfig.doseMl and flowUlPerPulse, for the flow meters
+#define EEPROM_MEM_VERSION 2
+
+struct EEPROM_MEM {
+  uint8_t magic;
+  uint8_t version;
+  PumpConfig pumpConfigs[3];
+  SensorConfig sensorConfig;
+};
+
+#endif /* EEPROM_MEM_H */
@@ -0,0 +1,42 @@
+#ifndef EVAPOTRANSPIRATION_H
+#define EVAPOTRANSPIRATION_H
+
+#include <Arduino.h>
+
+/**
+ * Cheap estimate of how fast the plants are drinking, from the DHT22 and the light sensor.
+ * Vapour pressure deficit from a saturation pressure table (Tetens, 1C steps),
+ * weighted by the light. Everything is integer, no float/exp on the 328P.
+ */
+
+// 1.0 in the fixed point factors
+#define ET_FACTOR_ONE 256
+// The factor is 1.0 at this VPD (Pa) under full light
+// (a mild, typical day: the configured frequency and secondsPump apply as they are)
+#define ET_REFERENCE_VPD 600
+// Weight of the light at 0% (of ET_FACTOR_ONE), it grows linearly to 1.0 at 100%
+#define ET_LIGHT_BASE 64
+// Limits of the demand estimate, intervals and doses change by 2x at most
+#define ET_FACTOR_MIN (ET_FACTOR_ONE / 4)
+#define ET_FACTOR_MAX (ET_FACTOR_ONE * 4)
+
+#define ET_MIN_TEMPERATURE 0
+#define ET_MAX_TEMPERATURE 45
+
+/**
+ * Vapour pressure deficit in Pa.
+ */
+uint16_t vapourPressureDeficit(int8_t temperature, uint8_t humidity);
+
+/**
+ * Evaporative demand relative to the reference, ET_FACTOR_ONE = 1.0, clamped to ET_FACTOR_MIN..ET_FACTOR_MAX.
+ */
+uint16_t evapotranspirationFactor(int8_t temperature, uint8_t humidity, uint8_t light);
+
+/**
+ * Square root of the factor, same fixed point. Interval and dose are both scaled by it,
+ * so the water delivered follows the factor itself.
+ */
+uint16_t evapotranspirationScale(int8_t temperature, uint8_t humidity, uint8_t light);
+
+#endif /* EVAPOTRANSPIRATION_H */
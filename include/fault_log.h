@@ -0,0 +1,29 @@
+#ifndef FAULT_LOG_H
+#define FAULT_LOG_H
+
+#include <stdint.h>
+
+/**
+ * Last faults, kept in the EEPROM for diagnostics.
+ */
+#define FAULT_LOG_SIZE 4
+#define FAULT_LOG_MAGIC 0x5A
+
+#define FAULT_LEAK 1 // The leak/overflow probe got wet
+
+struct FaultRecord
+{
+  uint32_t uptimeMs;
+  uint8_t code;         // FAULT_*
+  uint8_t pumpsRunning; // Bit i = pump i was running
+};
+
+struct FaultLog
+{
+  uint8_t magic;
+  uint8_t total; // Faults ever logged, stops at 255
+  uint8_t next;  // Record to overwrite next
+  FaultRecord records[FAULT_LOG_SIZE];
+};
+
+#endif /* FAULT_LOG_H */
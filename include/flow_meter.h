@@ -0,0 +1,41 @@
+#ifndef FLOW_METER_H
+#define FLOW_METER_H
+
+#include <Arduino.h>
+
+/**
+ * Hall effect flow meters, one per pump, counted by the pin change interrupt: no polling,
+ * and a few us per pulse. All the meters are on the same port, so one read of its PINx
+ * register gives every rising edge at once.
+ */
+#define FLOW_MAX_METERS 3
+
+struct FlowMeters
+{
+  volatile uint8_t* pin; // PINx register of the port
+  uint8_t count;
+  uint8_t masks[FLOW_MAX_METERS];
+  uint8_t lastState;
+  volatile uint16_t pulses[FLOW_MAX_METERS];
+};
+
+void flowMetersBegin(FlowMeters* meters, volatile uint8_t* pin);
+
+/**
+ * Register the meter of the next pump. Setup only, before enabling the interrupt.
+ */
+void flowMetersAdd(FlowMeters* meters, uint8_t mask);
+
+/**
+ * From the pin change ISR: count the rising edges.
+ */
+void flowMetersOnPinChange(FlowMeters* meters);
+
+/**
+ * Pulses counted since the last reset, read with the interrupts off.
+ */
+uint16_t flowMetersPulses(FlowMeters* meters, uint8_t idx);
+
+void flowMetersReset(FlowMeters* meters, uint8_t idx);
+
+#endif /* FLOW_METER_H */
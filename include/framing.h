@@ -0,0 +1,30 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <stdint.h>
+
+/**
+ * Framing of the telemetry link, kept apart from the serial port so it also
+ * builds on the host (see [env:native]).
+ */
+
+/**
+ * CRC-16/CCITT-FALSE (poly 0x1021), start with 0xFFFF.
+ */
+uint16_t crc16Update(uint16_t crc, uint8_t data);
+
+// Worst case COBS size of len bytes, without the delimiter
+#define COBS_ENCODED_SIZE(len) ((len) + (len) / 254 + 1)
+
+/**
+ * COBS encode len bytes from in to out, without the trailing delimiter.
+ * out must hold at least COBS_ENCODED_SIZE(len) bytes. Returns the encoded length.
+ */
+uint16_t cobsEncode(const uint8_t* in, uint16_t len, uint8_t* out);
+
+/**
+ * Decode a COBS block (without the delimiter) in place. Returns the decoded length, 0 if malformed.
+ */
+uint16_t cobsDecode(uint8_t* buf, uint16_t len);
+
+#endif /* FRAMING_H */
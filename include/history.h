@@ -0,0 +1,60 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+
+/**
+ * Fixed size history of the sensors, one sample every HISTORY_INTERVAL_MIN.
+ * Each channel keeps the oldest value plus a ring of 4 bits deltas, so 24h of
+ * 6 channels fit in ~160 bytes.
+ */
+#define HISTORY_INTERVAL_MIN 30
+#define HISTORY_SAMPLES 48 // deltas kept, i.e. HISTORY_SAMPLES + 1 values
+// Deltas are stored in steps of (1 << HISTORY_DELTA_SHIFT), -8..7 steps per sample
+#define HISTORY_DELTA_SHIFT 1
+#define HISTORY_MAGIC 0xA5
+
+#define HISTORY_SOIL 0 // + pump index
+#define HISTORY_LIGHT 3
+#define HISTORY_TEMPERATURE 4
+#define HISTORY_HUMIDITY 5
+#define HISTORY_CHANNELS 6
+
+// Temperature is signed, stored shifted into 0-255
+#define HISTORY_TEMPERATURE_OFFSET 40
+
+struct HistoryChannel
+{
+  uint8_t base; // Oldest value
+  uint8_t last; // Newest value, as the decoder sees it
+  uint8_t deltas[HISTORY_SAMPLES / 2];
+};
+
+struct History
+{
+  uint8_t magic;
+  uint8_t head;  // Oldest delta
+  uint8_t count; // Values stored, the deltas are one less
+  HistoryChannel channels[HISTORY_CHANNELS];
+};
+
+void historyClear(History* history);
+
+/**
+ * Check if the history (e.g. read back from the EEPROM) is consistent.
+ */
+bool historyIsValid(const History* history);
+
+/**
+ * Append one value per channel. When full, the oldest sample is dropped.
+ * Changes bigger than the delta range are followed over the next samples.
+ */
+void historyPush(History* history, const uint8_t values[HISTORY_CHANNELS]);
+
+/**
+ * Decode a channel, oldest first, into out (HISTORY_SAMPLES + 1 values).
+ * Returns the number of values.
+ */
+uint8_t historyRead(const History* history, uint8_t channel, uint8_t* out);
+
+#endif /* HISTORY_H */
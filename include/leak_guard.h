@@ -0,0 +1,60 @@
+#ifndef LEAK_GUARD_H
+#define LEAK_GUARD_H
+
+#include <Arduino.h>
+
+/**
+ * Leak/overflow cut-off: a float switch or leak probe pulls its pin low when wet.
+ * The pin change ISR forces every pump output low right there, without waiting for
+ * checkSchedule(), and latches the fault until it is acknowledged.
+ * The port registers and bitmasks are looked up once at setup, so the ISR is only a few
+ * register writes (a couple of us from the edge at 16MHz).
+ */
+#define LEAK_MAX_OUTPUTS 4
+
+struct LeakOutput
+{
+  volatile uint8_t* port;
+  uint8_t mask;
+  volatile uint8_t* tccr; // Timer control register of the PWM (TIMSK2 for the software one), NULL if none
+  uint8_t comMask;        // COM bits connecting the timer to the pin (TOIE2 setting it)
+};
+
+struct LeakGuard
+{
+  volatile uint8_t* sensorPin; // PINx register of the probe
+  uint8_t sensorMask;
+  uint8_t outputsCount;
+  LeakOutput outputs[LEAK_MAX_OUTPUTS];
+  volatile bool tripped;
+};
+
+void leakGuardBegin(LeakGuard* guard, volatile uint8_t* sensorPin, uint8_t sensorMask);
+
+/**
+ * Register a pump output. Setup only, before enabling the interrupt.
+ */
+void leakGuardAddOutput(LeakGuard* guard, volatile uint8_t* port, uint8_t mask, volatile uint8_t* tccr, uint8_t comMask);
+
+/**
+ * The probe reads wet right now.
+ */
+bool leakGuardIsWet(const LeakGuard* guard);
+
+/**
+ * Force every output low, disconnecting the PWM so it doesn't drive the pin again.
+ */
+void leakGuardCut(LeakGuard* guard);
+
+/**
+ * From the ISR (and the loop, in case an edge was missed): cut the outputs and latch
+ * the fault if the probe is wet.
+ */
+void leakGuardCheck(LeakGuard* guard);
+
+/**
+ * Clear the fault. Refused (returns false) while the probe is still wet.
+ */
+bool leakGuardAcknowledge(LeakGuard* guard);
+
+#endif /* LEAK_GUARD_H */
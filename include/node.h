@@ -0,0 +1,124 @@
+#ifndef NODE_H
+#define NODE_H
+
+#include <Arduino.h>
+#include <stddef.h>
+
+#include "eeprom_mem.h"
+#include "pump.h"
+#include "sensor_data.h"
+
+/**
+ * Multi-board setup: each board (node) is an I2C slave exposing its state as a register map,
+ * a coordinator board polls them and staggers their pumps.
+ * Node n answers at NODE_I2C_BASE_ADDRESS + n.
+ * Nodes run headless: their SSD1306 would answer at 0x3C on the shared bus, all of them along
+ * with the coordinator's.
+ */
+#define NODE_I2C_BASE_ADDRESS 0x20
+#define NODE_I2C_CLOCK 100000ul
+// Wire can't move more than this in one transaction
+#define NODE_I2C_CHUNK 32
+// Without a word from the coordinator for this long, a held node schedules its pumps itself
+#define NODE_HOLD_TIMEOUT_MS 10000ul
+
+#define NODE_REGISTERS_VERSION 1
+
+#define NODE_COMMAND_NONE 0
+#define NODE_COMMAND_START_PUMP 1 // commandArg = pump
+#define NODE_COMMAND_STOP_PUMP 2  // commandArg = pump
+#define NODE_COMMAND_COMMIT_CONFIG 3 // validate and save the config registers
+#define NODE_COMMAND_RELOAD_CONFIG 4 // drop what was written to the config registers
+
+#define NODE_STATUS_OK 0
+#define NODE_STATUS_BUSY 1
+#define NODE_STATUS_BAD_COMMAND 2
+#define NODE_STATUS_INVALID_CONFIG 3
+
+/**
+ * The register address is the byte offset in this struct.
+ */
+struct NodeRegisters
+{
+  uint8_t version;      // read only, NODE_REGISTERS_VERSION
+  uint8_t pumpsRunning; // read only, bit i = pump i
+  uint8_t pumpsDue;     // read only, interval elapsed while held
+  uint8_t hold;         // read/write, don't start scheduled pumps while set
+  uint8_t command;      // read/write, NODE_COMMAND_*, cleared once done
+  uint8_t commandArg;   // read/write
+  uint8_t commandStatus; // read only, NODE_STATUS_*
+  SensorData sensorData; // read only
+  EEPROM_MEM config;     // read/write, applied by NODE_COMMAND_COMMIT_CONFIG
+};
+
+#define NODE_REG_VERSION offsetof(NodeRegisters, version)
+#define NODE_REG_HOLD offsetof(NodeRegisters, hold)
+#define NODE_REG_COMMAND offsetof(NodeRegisters, command)
+#define NODE_REG_CONFIG offsetof(NodeRegisters, config)
+// What the coordinator polls: everything before the config
+#define NODE_STATUS_SIZE offsetof(NodeRegisters, config)
+
+void nodeBegin(NodeRegisters* regs);
+
+/**
+ * Copy registers out, from the I2C request handler. Reads past the end return 0xFF.
+ */
+void nodeRead(const NodeRegisters* regs, uint8_t reg, uint8_t* buf, uint8_t len);
+
+/**
+ * Write registers, from the I2C receive handler. Read only registers are left alone.
+ * Returns true if the config registers were written: they hold a staged config until committed.
+ */
+bool nodeWrite(NodeRegisters* regs, uint8_t reg, const uint8_t* buf, uint8_t len);
+
+/**
+ * The hold stands, i.e. it's set and the coordinator read or wrote the registers since
+ * lastContactMs, less than NODE_HOLD_TIMEOUT_MS ago.
+ */
+bool nodeIsHeld(const NodeRegisters* regs, uint32_t lastContactMs, uint32_t currentMillis);
+
+/**
+ * Bitmask of the pumps whose interval elapsed, i.e. the ones that would start if not held.
+ */
+uint8_t nodeDuePumps(Pump* pumps, uint8_t pumpsCount, uint32_t currentMillis);
+
+/**
+ * Coordinator side.
+ */
+#define COORDINATOR_MAX_NODES 32
+// Nodes allowed to start pumps at the same time
+#define COORDINATOR_MAX_ACTIVE 1
+#define COORDINATOR_POLL_MS 1000
+
+struct NodeStatus
+{
+  uint8_t online;
+  uint8_t hold;
+  uint8_t pumpsRunning;
+  uint8_t pumpsDue;
+};
+
+struct Coordinator
+{
+  uint8_t nodesCount;
+  uint8_t next; // Round robin start, so every node gets its turn
+  NodeStatus nodes[COORDINATOR_MAX_NODES];
+};
+
+/**
+ * Bus access, so the same coordinator runs on Wire or on the host simulated bus.
+ */
+typedef bool (*BusRead)(uint8_t address, uint8_t reg, uint8_t* buf, uint8_t len);
+typedef bool (*BusWrite)(uint8_t address, uint8_t reg, const uint8_t* buf, uint8_t len);
+// Called with the status registers (NODE_STATUS_SIZE bytes) of each node that answered
+typedef void (*NodeStatusCallback)(uint8_t node, const uint8_t* status);
+
+void coordinatorBegin(Coordinator* coordinator, uint8_t nodesCount);
+
+/**
+ * Read the status of every node, then release up to COORDINATOR_MAX_ACTIVE nodes with due pumps
+ * (counting the ones already running) and hold every other one.
+ */
+void coordinatorPoll(Coordinator* coordinator, BusRead busRead, BusWrite busWrite, NodeStatusCallback onStatus);
+
+#endif /* NODE_H */
@@ -5,6 +5,33 @@
 #include "pump_config.h"
 #include "sensor_data.h"
 
+/**
+ * What the scheduler wants done with a pump.
+ */
+enum PumpAction {
+  PUMP_IDLE,
+  PUMP_START,
+  PUMP_STOP,
+  PUMP_GAIN_LEARNED // Adaptive dosing measured a new doseGain, worth saving
+};
+
+/**
+ * Runtime state of a pump (everything but its config), kept across a warm restart.
+ */
+struct PumpRuntime {
+  uint32_t lastRunMs;
+  uint32_t startedAtMs;
+  bool running;
+  uint16_t runSeconds;
+  uint8_t doseStartMoisture;
+  uint32_t stoppedAtMs;
+  bool settling;
+  uint32_t etElapsedMs;
+  uint32_t etUpdatedMs;
+  uint16_t etFactor;
+  uint16_t targetPulses;
+};
+
 class Pump {
   private:
     uint32_t lastRunMs;
@@ -12,6 +39,19 @@ class Pump {
     PumpConfig config;
     uint8_t pin;
     bool running = false;
+    // Adaptive dosing
+    uint16_t runSeconds;
+    uint8_t doseStartMoisture;
+    uint32_t stoppedAtMs;
+    bool settling = false;
+    // Evapotranspiration scheduling: time since the last run, weighted by etFactor (the ET scale)
+    uint32_t etElapsedMs;
+    uint32_t etUpdatedMs;
+    uint16_t etFactor;
+    // Volumetric dosing: flow meter pulses to stop at, 0 when dosing by time
+    uint16_t targetPulses;
+    uint32_t intervalMs();
+    uint32_t elapsedMs(uint32_t currentMillis);
   public:
     Pump(uint8_t pin);
     void setLastRunMs(uint32_t lastRunMs);
@@ -23,13 +63,54 @@ class Pump {
     void setRunning(bool running);
     uint32_t getStartedAtMs();
     void setStartedAtMs(uint32_t startedAtMs);
+    /**
+     * Start a run, sized by doseSeconds(), or by doseMl with a flow meter.
+     */
+    void start(uint32_t currentMillis, uint8_t soilMoisture);
+    void stop(uint32_t currentMillis);
+    /**
+     * Length of the current (or next) run
+     */
+    uint16_t getRunSeconds();
+    /**
+     * How long to pump from this moisture: secondsPump, or in adaptive mode just
+     * enough to reach soilSensor + DOSE_TARGET_BAND with the learned gain (capped by secondsPump).
+     */
+    uint16_t doseSeconds(uint8_t soilMoisture);
+    /**
+     * Last evapotranspiration scale seen by isTimeToRun(), ET_FACTOR_ONE = 1.0
+     */
+    uint16_t getEtFactor();
+    PumpRuntime getRuntime();
+    void setRuntime(PumpRuntime runtime);
+    /**
+     * Doses a volume: doseMl and the flow meter calibration are set.
+     * The adaptive sizing doesn't apply then, secondsPump is the safety limit of the run.
+     */
+    bool isVolumetric();
+    /**
+     * The flow meter counted the dose of the current run (doseMl, scaled like the time in ET mode).
+     */
+    bool isDoseReached(uint16_t pulses);
+    uint16_t pulsesToMl(uint16_t pulses);
     void incFrequency(bool up);
     void incSecondsPump(bool up);
     void incPumpPower(bool up);
     void incSoilSensor(bool up);
     void incLightSensor(bool up);
-    uint16_t secondsToNextRun(unsigned long currentMillis);
-    bool isTimeToRun(unsigned long currentMillis, SensorData sensorData, uint8_t idx);
+    void incMode(bool up);
+    void incDoseMl(bool up);
+    uint16_t secondsToNextRun(uint32_t currentMillis);
+    /**
+     * Interval elapsed, without checking the sensors nor restarting the interval.
+     */
+    bool isDue(uint32_t currentMillis);
+    bool isTimeToRun(uint32_t currentMillis, SensorData sensorData, uint8_t idx);
+    /**
+     * Check if the pump should start (interval elapsed and sensors agree) or stop (ran long enough).
+     * Doesn't change the running state, the caller starts/stops the pump.
+     */
+    PumpAction checkSchedule(uint32_t currentMillis, SensorData sensorData, uint8_t idx);
 };
 
 #endif /* PUMP_H */
\ No newline at end of file
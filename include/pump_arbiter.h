@@ -0,0 +1,60 @@
+#ifndef PUMP_ARBITER_H
+#define PUMP_ARBITER_H
+
+#include <Arduino.h>
+
+#include "pump.h"
+
+/**
+ * Keeps the pumps inside the power budget of the shared supply: starts are queued,
+ * admitted in order while the budget allows, and ramped up to their power.
+ * The queue is strict FIFO, a pump never waits for more than the runs queued before it
+ * (at most (pumps - 1) * (MAX_SECONDS_PUMP + ARBITER_SOFT_START_MS)).
+ */
+// Pumps running at the same time
+#define ARBITER_MAX_PUMPS 1
+// Sum of the power (%) of the running pumps. A pump above it still runs, alone.
+#define ARBITER_MAX_POWER 100
+// PWM ramp from 0 to the pump power. A pump is only admitted once the others are done ramping.
+#define ARBITER_SOFT_START_MS 1000
+#define ARBITER_QUEUE_SIZE 8
+
+#define ARBITER_NONE 0xFF
+
+struct PumpArbiter
+{
+  uint8_t queue[ARBITER_QUEUE_SIZE]; // Pump indexes, oldest first
+  uint8_t queued;
+};
+
+void arbiterBegin(PumpArbiter* arbiter);
+
+/**
+ * Queue a start. Returns false if the pump is already queued or the queue is full.
+ */
+bool arbiterRequest(PumpArbiter* arbiter, uint8_t pumpIdx);
+
+/**
+ * Drop a queued start, e.g. when cancelled before it was admitted.
+ */
+void arbiterCancel(PumpArbiter* arbiter, uint8_t pumpIdx);
+
+bool arbiterIsQueued(const PumpArbiter* arbiter, uint8_t pumpIdx);
+
+/**
+ * Bit i is set if pump i is queued.
+ */
+uint8_t arbiterQueuedMask(const PumpArbiter* arbiter);
+
+/**
+ * Pop the oldest queued pump if it fits the budget now, ARBITER_NONE otherwise.
+ * The caller starts it, so its run is timed from here and it gets its full length.
+ */
+uint8_t arbiterNext(PumpArbiter* arbiter, Pump* pumps, uint8_t pumpsCount, uint32_t currentMillis);
+
+/**
+ * PWM duty (0-255) of a pump, ramping during the first ARBITER_SOFT_START_MS of its run.
+ */
+uint8_t arbiterDuty(Pump* pump, uint32_t currentMillis);
+
+#endif /* PUMP_ARBITER_H */
@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 
+// One pump and one soil probe per output
+#define NUM_PUMPS 3
+
 #define STEPS_FREQUENCY 5
 #define DEFAULT_FREQUENCY 30
 #define MAX_FREQUENCY 1440
@@ -28,12 +31,43 @@
 #define STEPS_PUMP_POWER 5
 #define DEFAULT_PUMP_POWER 80
 
+// Volumetric dosing, needs a flow meter (flowUlPerPulse set). 0 doses by time.
+#define STEPS_DOSE_ML 10
+#define DEFAULT_DOSE_ML 0
+#define MAX_DOSE_ML 2000
+#define MIN_DOSE_ML 0
+
+// Flow meter calibration, ul per pulse (e.g. ~2200 for a YF-S201). 0 if there is no meter.
+#define DEFAULT_FLOW_UL_PER_PULSE 0
+#define MAX_FLOW_UL_PER_PULSE 20000
+#define MIN_FLOW_UL_PER_PULSE 0
+
+// Mode flags
+#define PUMP_MODE_FIXED 0
+#define PUMP_MODE_ADAPTIVE 0x01 // Size each dose from the learned moisture rise per second
+#define PUMP_MODE_ET 0x02 // Stretch/shrink the interval and dose with the evapotranspiration estimate
+#define MAX_PUMP_MODE (PUMP_MODE_ADAPTIVE | PUMP_MODE_ET)
+#define MIN_PUMP_MODE 0
+#define DEFAULT_PUMP_MODE PUMP_MODE_FIXED
+
+// Adaptive dosing: wait for the water to spread before measuring the rise
+#define DOSE_SETTLE_MINUTES 10
+// Aim this much above soilSensor
+#define DOSE_TARGET_BAND 20
+// Weight (of 100) of the last measure when updating the learned gain
+#define DOSE_GAIN_ALPHA 50
+
+// Fixed width fields, so the EEPROM image is the same on the host (see plantlink.py)
 struct PumpConfig {
-  int frequency; // in minutes, for e.g. every 30min or 720min(12h)
-  int secondsPump; // Time in sec to keep the pump running
-  int power; // 1-100% power
+  int16_t frequency; // in minutes, for e.g. every 30min or 720min(12h)
+  int16_t secondsPump; // Time in sec to keep the pump running
+  int16_t power; // 1-100% power
   uint8_t soilSensor; // Run pump if it's below this level (0-100)
   uint8_t lightSensor; // Run pump if it's above this level (0-100)
+  uint8_t mode; // PUMP_MODE_* flags
+  uint8_t doseGain; // Learned moisture rise in % per 100 pumped seconds, 0 if not learned yet
+  uint16_t doseMl; // Stop once this much went through the flow meter, secondsPump is then only the safety limit
+  uint16_t flowUlPerPulse; // Flow meter calibration
 };
 
 #endif /* PUMP_CONFIG_H */
\ No newline at end of file
@@ -9,12 +9,18 @@
 #define MIN_LIGHT_SENSOR_CALIBRATION 0
 #define MAX_LIGHT_SENSOR_CALIBRATION 1023
 
+// Full ADC range until calibrated
+#define DEFAULT_SOIL_SENSOR_DRY_VALUE 1023
+#define DEFAULT_SOIL_SENSOR_WET_VALUE 0
+#define DEFAULT_LIGHT_SENSOR_DAY_VALUE 1023
+#define DEFAULT_LIGHT_SENSOR_NIGHT_VALUE 0
+
 struct SensorConfig
 {
-    int lightSensorDayValue;
-    int lightSensorNightValue;
-    int soilSensorDryValue[3];
-    int soilSensorWetValue[3];
+    int16_t lightSensorDayValue;
+    int16_t lightSensorNightValue;
+    int16_t soilSensorDryValue[3];
+    int16_t soilSensorWetValue[3];
 };
 
 #endif /* SENSOR_CONFIG_H */
@@ -0,0 +1,59 @@
+#ifndef SENSOR_SAMPLER_H
+#define SENSOR_SAMPLER_H
+
+#include <Arduino.h>
+
+/**
+ * The soil probes and the light sensor are powered from a GPIO, only while sampling:
+ * power them all, wait for them to settle, read every channel in one burst, power off.
+ * Saves their current and the electrolysis that corrodes the resistive probes.
+ */
+// Probes powered at the same time, the GPIO sources up to ~20mA
+#define SAMPLER_MAX_CHANNELS 4
+// Wait after power up before reading, capacitive probes need ~100ms to stabilise
+#define SAMPLER_SETTLE_MS 100
+// Reads averaged per channel, after one discarded read to let the ADC mux settle
+#define SAMPLER_BURST 4
+// Sampling interval while idle: the scheduler runs pumps every MIN_FREQUENCY minutes at most
+#define SAMPLER_INTERVAL_MS 60000ul
+// Sampling interval while a pump runs or someone is looking at the screen
+#define SAMPLER_ACTIVE_INTERVAL_MS 1000ul
+
+enum SamplerState
+{
+  SAMPLER_OFF,
+  SAMPLER_SETTLING
+};
+
+struct SensorSampler
+{
+  uint8_t powerPin;
+  uint8_t channelsCount;
+  const uint8_t* channels; // Analog pins
+  SamplerState state;
+  uint32_t poweredAtMs;
+  uint32_t sampledAtMs;
+  bool sampled; // At least one batch was read
+  uint16_t raw[SAMPLER_MAX_CHANNELS]; // Latest batch, raw ADC values
+};
+
+void samplerBegin(SensorSampler* sampler, uint8_t powerPin, const uint8_t* channels, uint8_t channelsCount);
+
+/**
+ * Power up the probes once intervalMs passed since the last batch, and read them once settled.
+ * Doesn't block, returns true when a new batch is in raw.
+ */
+bool samplerUpdate(SensorSampler* sampler, uint32_t currentMillis, uint32_t intervalMs);
+
+/**
+ * Take a batch right now, blocking for SAMPLER_SETTLE_MS. For the calibration, which needs
+ * the probe as it is at the time of the click.
+ */
+void samplerSampleNow(SensorSampler* sampler, uint32_t currentMillis);
+
+/**
+ * Probes powered, waiting to read: don't sleep now.
+ */
+bool samplerBusy(const SensorSampler* sampler);
+
+#endif /* SENSOR_SAMPLER_H */
@@ -0,0 +1,20 @@
+#ifndef SOFT_PWM_H
+#define SOFT_PWM_H
+
+#include <Arduino.h>
+
+/**
+ * PWM in software for the pump pins without a timer output (7 and 8 on the Nano), so they
+ * get the same soft start as pin 6. Timer2 runs in fast PWM mode at 16 MHz / 64 / 256 (~977 Hz),
+ * its overflow sets the pins and the compare matches A and B clear them, without using OC2A/OC2B
+ * (pins 11 and 3 stay free). The interrupts are off while no channel is between 0 and 255.
+ */
+#define SOFT_PWM_CHANNELS 2
+
+/**
+ * Set the duty (0-255) of a pin, taking a free channel the first time.
+ * Returns false if both channels are taken by other pins.
+ */
+bool softPwmWrite(uint8_t pin, uint8_t duty);
+
+#endif /* SOFT_PWM_H */
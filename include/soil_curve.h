@@ -0,0 +1,47 @@
+#ifndef SOIL_CURVE_H
+#define SOIL_CURVE_H
+
+#include <stdint.h>
+
+/**
+ * Piecewise linear calibration of the soil probes (capacitive probes are far from linear).
+ * The knots are the moisture (0-100) at evenly spaced raw readings, every
+ * 1 << SOIL_CURVE_SHIFT counts: the segment is raw >> SOIL_CURVE_SHIFT, no search,
+ * and the interpolation is one 8x8 bit multiply and a shift.
+ * The curves stay in the EEPROM, only the two knots around a reading are read.
+ * A probe without a curve maps its reading between its dry and wet values, as before.
+ */
+#define SOIL_CURVE_SHIFT 6
+#define SOIL_CURVE_KNOTS ((1024 >> SOIL_CURVE_SHIFT) + 1) // Raw 0, 64, ... 1024
+#define SOIL_CURVE_MAGIC 0xC5
+#define SOIL_CURVE_PROBES 3
+
+struct SoilCurves
+{
+  uint8_t magic;
+  uint8_t custom; // Bit i: probe i uses its knots, instead of its dry/wet line
+  uint8_t knots[SOIL_CURVE_PROBES][SOIL_CURVE_KNOTS];
+};
+
+/**
+ * Knot starting the segment of a raw reading (0-1023): the reading is between it and the next one.
+ */
+uint8_t soilCurveSegment(uint16_t raw);
+
+/**
+ * Moisture in % for a raw reading, from the knots of its segment.
+ */
+uint8_t soilCurveInterpolate(uint8_t low, uint8_t high, uint16_t raw);
+
+/**
+ * Every knot in 0-100, and monotonic (either way, the probes read lower or higher when wet).
+ */
+bool soilCurveIsValid(const uint8_t* knots);
+
+/**
+ * The straight line between the dry and wet readings, as the two point calibration does,
+ * sampled at the knots.
+ */
+void soilCurveLinear(uint8_t* knots, int dryValue, int wetValue);
+
+#endif /* SOIL_CURVE_H */
@@ -0,0 +1,104 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+#include "framing.h"
+#include "pump.h"
+#include "sensor_config.h"
+#include "sensor_data.h"
+
+#define TELEMETRY_BAUD 38400
+#define TELEMETRY_INTERVAL_MS 1000
+
+/**
+ * Frame types. Every frame is [type][seq][payload...][crc16 lo][crc16 hi],
+ * COBS encoded and terminated by a 0x00 delimiter.
+ * All multi-byte values are little endian.
+ */
+#define TELEMETRY_SENSOR_DATA 0x01  // uptime u32, temp i8, humid u8, light u8, soil u8[3], running mask u8
+#define TELEMETRY_PUMP_EVENT 0x02   // uptime u32, pump u8, running u8, ml u16 (measured on stop, 0 without a flow meter)
+#define TELEMETRY_PUMP_CONFIG 0x03  // pump u8, PumpConfig
+#define TELEMETRY_SENSOR_CONFIG 0x04 // SensorConfig
+#define TELEMETRY_NODE_STATUS 0x05   // node u8, status registers of the node (see node.h)
+#define TELEMETRY_FAULT 0x06         // uptime u32, fault code u8 (FAULT_*), running mask u8
+
+/**
+ * Commands sent by the host, using the same framing. Each one is answered by a
+ * COMMAND_REPLY frame: [command][status][data...].
+ */
+#define COMMAND_READ_CONFIG 0x10   // offset u8, len u8 -> EEPROM_MEM bytes from the running config
+#define COMMAND_WRITE_CONFIG 0x11  // offset u8, data... -> staged (in the EEPROM), not applied yet
+#define COMMAND_COMMIT_CONFIG 0x12 // crc16 of the whole staged EEPROM_MEM -> validated, applied and saved
+#define COMMAND_START_PUMP 0x13    // pump u8
+#define COMMAND_STOP_PUMP 0x14     // pump u8
+#define COMMAND_CALIBRATE 0x15     // target u8, pump u8 -> captured raw value u16
+#define COMMAND_GET_STATE 0x16     // -> uptime u32, running mask u8, SensorData, seconds to next run u16 per pump,
+                                   // fault u8, then with WARM_RESTART: reset flags u8, warm boot u8
+#define COMMAND_SAVE_CONFIG 0x17   // saves the running config (e.g. after calibrating)
+#define COMMAND_ACK_FAULT 0x18     // clears a latched fault, COMMAND_FAULT_ACTIVE while its cause is still there
+#define COMMAND_READ_FAULTS 0x19   // -> FaultLog
+#define COMMAND_READ_DOSES 0x1A    // run u8 (0 = oldest) -> runs logged u8, then if there is that run:
+                                   // uptime u32, seconds u16, ml u16, pump u8
+#define COMMAND_GET_CURVE 0x1B     // pump u8 -> soil curve knots u8[SOIL_CURVE_KNOTS]
+#define COMMAND_SET_CURVE 0x1C     // pump u8, knots u8[SOIL_CURVE_KNOTS] -> validated and saved
+#define COMMAND_REPLY 0x20
+
+#define COMMAND_OK 0x00
+#define COMMAND_BAD_REQUEST 0x01
+#define COMMAND_INVALID_CONFIG 0x02
+#define COMMAND_CRC_MISMATCH 0x03
+#define COMMAND_FAULT_ACTIVE 0x04
+
+#define CALIBRATE_SOIL_DRY 0
+#define CALIBRATE_SOIL_WET 1
+#define CALIBRATE_LIGHT_DAY 2
+#define CALIBRATE_LIGHT_NIGHT 3
+#define CALIBRATE_FLOW 4 // + ml u16 measured for the last run -> flow calibration in ul/pulse u16
+#define CALIBRATE_SOIL_RAW 5 // Only read the soil probe, for a multi point calibration
+
+// Biggest payload, before the header, CRC and COBS overhead
+#define TELEMETRY_MAX_PAYLOAD 32
+#define TELEMETRY_MAX_FRAME (TELEMETRY_MAX_PAYLOAD + 4)
+// COBS overhead and the delimiter
+#define TELEMETRY_MAX_ENCODED (COBS_ENCODED_SIZE(TELEMETRY_MAX_FRAME) + 1)
+
+/**
+ * Start the serial port used to stream the telemetry.
+ */
+void telemetryBegin();
+
+/**
+ * Frame and queue a message into the serial TX buffer, which is drained by the UART interrupt.
+ * Never blocks: if there is not enough room for the whole frame it's dropped,
+ * the host can detect it through the sequence number.
+ */
+bool telemetrySend(uint8_t type, const uint8_t* payload, uint8_t len);
+
+void telemetrySensorData(uint32_t now, SensorData sensorData, uint8_t runningMask);
+void telemetryPumpEvent(uint32_t now, uint8_t pumpIdx, bool running, uint16_t ml);
+void telemetryFault(uint32_t now, uint8_t code, uint8_t runningMask);
+/**
+ * Send the whole configuration. It doesn't fit the TX buffer at once, so it waits
+ * for each frame to go out: only meant to be called from setup().
+ */
+void telemetryConfig(Pump* pumps, uint8_t pumpsCount, SensorConfig sensorConfig);
+
+/**
+ * Reply to a command received through telemetryReceive().
+ */
+bool telemetryReply(uint8_t command, uint8_t status, const uint8_t* data, uint8_t len);
+
+/**
+ * Read whatever arrived on the serial port, without blocking.
+ * Returns true when a whole frame with a valid CRC is available: its type and payload are copied out,
+ * payload must hold TELEMETRY_MAX_PAYLOAD bytes.
+ */
+bool telemetryReceive(uint8_t* type, uint8_t* payload, uint8_t* len);
+
+/**
+ * Wait until the frames already queued are out, e.g. before the clock stops in sleep mode.
+ */
+void telemetryFlush();
+
+#endif /* TELEMETRY_H */
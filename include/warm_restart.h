@@ -0,0 +1,95 @@
+#ifndef WARM_RESTART_H
+#define WARM_RESTART_H
+
+#include <Arduino.h>
+
+#include "pump.h"
+#include "pump_arbiter.h"
+#include "sensor_data.h"
+
+/**
+ * Warm restart: the runtime state is mirrored in a .noinit block, which the C runtime leaves
+ * alone at reset, sealed with a CRC. After a watchdog or brown-out reset, setup() carries on
+ * from it: the uptime, the schedules, the run in progress and the sensor filters.
+ * A power on or external reset (e.g. an upload), or a bad CRC, is a cold boot.
+ * Optiboot clears MCUSR and hands it over in r2, then leaves through a watchdog reset after the
+ * reset button or an upload: only a timeout marked by the watchdog interrupt counts as ours.
+ * The interrupt comes 500 ms into a hang and the reset 500 ms after it: a hang with the
+ * interrupts off for more than 500 ms can't run it, and boots cold.
+ * To check the handoff with another bootloader, `plant_cli.py state` must show a cold boot
+ * with EXTRF after the reset button.
+ */
+#define WARM_STATE_VERSION 1
+#define WARM_SAVE_MS 100
+// Consecutive warm restarts before giving up on the state, in case it's what crashes
+#define WARM_MAX_RESTARTS 3
+// Running this long after a warm restart clears the count
+#define WARM_STABLE_MS 60000ul
+#define WARM_MAX_PUMPS 3
+// The times of a pump are kept as the age at uptimeMs, in 2.048 s ticks: up to 37 h, past the
+// longest interval, and a few bytes less than PumpRuntime
+#define WARM_TICK_SHIFT 11
+
+#define WARM_PUMP_RUNNING 0x01
+#define WARM_PUMP_SETTLING 0x02
+
+struct WarmPump
+{
+  uint16_t lastRunAge;
+  uint16_t startedAge;
+  uint16_t stoppedAge;
+  uint16_t etUpdatedAge;
+  uint32_t etElapsedMs;
+  uint16_t runSeconds;
+  uint16_t etFactor;
+  uint16_t targetPulses;
+  uint8_t doseStartMoisture;
+  uint8_t flags; // WARM_PUMP_*
+};
+
+struct WarmState
+{
+  uint8_t version;
+  uint8_t restarts; // Consecutive warm restarts
+  uint32_t uptimeMs;
+  WarmPump pumps[WARM_MAX_PUMPS];
+  uint16_t flowPulses[WARM_MAX_PUMPS];
+  SensorData sensorData;
+  PumpArbiter arbiter;
+  bool faultLatched;
+  uint16_t crc; // Of everything above
+};
+
+/**
+ * Arm the watchdog, interrupt then reset: the first timeout marks the reset the second one does.
+ */
+void warmWatchdogEnable();
+
+/**
+ * From the loop. Re-arms the interrupt, which the hardware disables once it ran.
+ */
+void warmWatchdogReset();
+
+/**
+ * MCUSR at boot, from the bootloader's r2 if it cleared it, 0 if r2 couldn't be one.
+ */
+uint8_t warmResetFlags();
+
+/**
+ * The reset was a watchdog or brown-out one, and the state is intact and not restarting in a loop.
+ */
+bool warmStateIsValid(const WarmState* state);
+
+void warmPackPump(WarmPump* warm, const PumpRuntime* runtime, uint32_t uptimeMs);
+
+/**
+ * Back to the times at uptimeMs, saturated ages come back as old as they can.
+ */
+void warmUnpackPump(PumpRuntime* runtime, const WarmPump* warm, uint32_t uptimeMs);
+
+/**
+ * Compute the CRC, once the state is filled.
+ */
+void warmStateSeal(WarmState* state);
+
+#endif /* WARM_RESTART_H */
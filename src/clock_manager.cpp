@@ -0,0 +1,40 @@
+#include "clock_manager.h"
+#include <avr/power.h>
+
+void clockBegin(ClockManager* clock, const ClockTiming* timings)
+{
+  clock->timings = timings;
+  clock->slow = false;
+  clock->rawMs = millis();
+  clock->baseMs = clock->rawMs;
+}
+
+void clockResume(ClockManager* clock, uint32_t uptimeMs)
+{
+  clock->rawMs = millis();
+  clock->baseMs = uptimeMs;
+}
+
+uint32_t clockMillis(const ClockManager* clock)
+{
+  // timer0 ticks 2^shift slower, and millis() with it
+  return clock->baseMs + ((millis() - clock->rawMs) << (clock->slow ? CLOCK_SLOW_SHIFT : 0));
+}
+
+void clockSetSlow(ClockManager* clock, bool slow)
+{
+  if (slow == clock->slow)
+  {
+    return;
+  }
+  const ClockTiming* timing = &clock->timings[slow ? 1 : 0];
+  uint32_t now = clockMillis(clock);
+  noInterrupts();
+  clock_prescale_set(slow ? (clock_div_t)CLOCK_SLOW_SHIFT : clock_div_1);
+  UBRR0 = timing->ubrr;
+  ADCSRA = (ADCSRA & ~0b00000111) | timing->adcPrescaler;
+  clock->slow = slow;
+  clock->rawMs = millis();
+  clock->baseMs = now;
+  interrupts();
+}
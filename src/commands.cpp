@@ -0,0 +1,229 @@
+#include "commands.h"
+
+#include "configuration.h"
+#include "telemetry.h"
+
+void handleCommand(uint32_t now, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+  uint8_t reply[TELEMETRY_MAX_PAYLOAD - 2];
+  uint8_t replyLen = 0;
+  uint8_t status = COMMAND_OK;
+
+  switch (type)
+  {
+  case COMMAND_READ_CONFIG:
+  {
+    EEPROM_MEM mem = currentConfig(pumps, NUM_PUMPS, sensorConfig);
+    if (len != 2 || payload[0] >= sizeof(EEPROM_MEM) || payload[1] > sizeof(reply))
+    {
+      status = COMMAND_BAD_REQUEST;
+      break;
+    }
+    replyLen = sizeof(EEPROM_MEM) - payload[0];
+    if (payload[1] < replyLen)
+    {
+      replyLen = payload[1];
+    }
+    memcpy(reply, ((uint8_t *)&mem) + payload[0], replyLen);
+    break;
+  }
+  case COMMAND_WRITE_CONFIG:
+    if (len < 1 || payload[0] + len - 1u > sizeof(EEPROM_MEM))
+    {
+      status = COMMAND_BAD_REQUEST;
+      break;
+    }
+    // Staged in the EEPROM rather than in RAM, it's applied only once complete and valid
+    EEPROM.updateBlock(EEPROM_STAGED_ADDR + payload[0], payload + 1, len - 1);
+    break;
+  case COMMAND_COMMIT_CONFIG:
+  {
+    EEPROM_MEM stagedConfig;
+    EEPROM.readBlock(EEPROM_STAGED_ADDR, stagedConfig);
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < sizeof(EEPROM_MEM); i++)
+    {
+      crc = crc16Update(crc, ((uint8_t *)&stagedConfig)[i]);
+    }
+    if (len != 2 || crc != (payload[0] | (payload[1] << 8)))
+    {
+      status = COMMAND_CRC_MISMATCH;
+    }
+    else if (!validateConfig(stagedConfig, NUM_PUMPS))
+    {
+      status = COMMAND_INVALID_CONFIG;
+    }
+    else
+    {
+      for (uint8_t i = 0; i < NUM_PUMPS; i++)
+      {
+        pumps[i].setConfig(stagedConfig.pumpConfigs[i]);
+      }
+      setSensorConfig(stagedConfig.sensorConfig);
+      saveConfig();
+    }
+    break;
+  }
+  case COMMAND_START_PUMP:
+  case COMMAND_STOP_PUMP:
+    if (len != 1 || payload[0] >= NUM_PUMPS)
+    {
+      status = COMMAND_BAD_REQUEST;
+    }
+    else if (type == COMMAND_START_PUMP)
+    {
+      if (faultActive())
+      {
+        status = COMMAND_FAULT_ACTIVE;
+      }
+      else
+      {
+        requestPump(payload[0]);
+      }
+    }
+    else
+    {
+      stopPump(payload[0]);
+    }
+    break;
+  case COMMAND_CALIBRATE:
+  {
+    bool flow = len > 0 && payload[0] == CALIBRATE_FLOW;
+    if (len != (flow ? 4 : 2) || payload[1] >= NUM_PUMPS)
+    {
+      status = COMMAND_BAD_REQUEST;
+      break;
+    }
+    int value;
+    switch (payload[0])
+    {
+    case CALIBRATE_SOIL_DRY:
+      value = sensorConfig.soilSensorDryValue[payload[1]] = readSoilSensorRaw(payload[1]);
+      resetSoilCurve(payload[1]);
+      break;
+    case CALIBRATE_SOIL_WET:
+      value = sensorConfig.soilSensorWetValue[payload[1]] = readSoilSensorRaw(payload[1]);
+      resetSoilCurve(payload[1]);
+      break;
+    case CALIBRATE_LIGHT_DAY:
+      value = sensorConfig.lightSensorDayValue = readLightSensorRaw();
+      break;
+    case CALIBRATE_LIGHT_NIGHT:
+      value = sensorConfig.lightSensorNightValue = readLightSensorRaw();
+      break;
+    case CALIBRATE_SOIL_RAW:
+      value = readSoilSensorRaw(payload[1]);
+      break;
+    case CALIBRATE_FLOW:
+      value = calibrateFlow(payload[1], payload[2] | (payload[3] << 8));
+      if (value == 0)
+      {
+        status = COMMAND_BAD_REQUEST;
+      }
+      break;
+    default:
+      status = COMMAND_BAD_REQUEST;
+      value = 0;
+      break;
+    }
+    reply[replyLen++] = value;
+    reply[replyLen++] = value >> 8;
+    break;
+  }
+  case COMMAND_GET_STATE:
+  {
+    memcpy(reply, &now, 4);
+    replyLen = 4;
+    reply[replyLen++] = pumpsRunningMask();
+    memcpy(reply + replyLen, &sensorData, sizeof(SensorData));
+    replyLen += sizeof(SensorData);
+    for (uint8_t i = 0; i < NUM_PUMPS; i++)
+    {
+      uint16_t secs = pumps[i].secondsToNextRun(now);
+      reply[replyLen++] = secs;
+      reply[replyLen++] = secs >> 8;
+    }
+    reply[replyLen++] = faultActive();
+    replyLen += bootState(reply + replyLen);
+    break;
+  }
+  case COMMAND_SAVE_CONFIG:
+    saveConfig();
+    break;
+  case COMMAND_GET_CURVE:
+    if (len != 1 || payload[0] >= NUM_PUMPS)
+    {
+      status = COMMAND_BAD_REQUEST;
+      break;
+    }
+    soilCurve(payload[0], reply);
+    replyLen = SOIL_CURVE_KNOTS;
+    break;
+  case COMMAND_SET_CURVE:
+    if (len != SOIL_CURVE_KNOTS + 1 || payload[0] >= NUM_PUMPS)
+    {
+      status = COMMAND_BAD_REQUEST;
+    }
+    else if (!soilCurveIsValid(payload + 1))
+    {
+      status = COMMAND_INVALID_CONFIG;
+    }
+    else
+    {
+      setSoilCurve(payload[0], payload + 1);
+    }
+    break;
+  case COMMAND_ACK_FAULT:
+    if (!acknowledgeFault())
+    {
+      status = COMMAND_FAULT_ACTIVE;
+    }
+    break;
+  case COMMAND_READ_FAULTS:
+  {
+    FaultLog log;
+    loadFaultLog(&log);
+    // Field by field, the same on the host where FaultRecord is padded
+    reply[replyLen++] = log.magic;
+    reply[replyLen++] = log.total;
+    reply[replyLen++] = log.next;
+    for (uint8_t i = 0; i < FAULT_LOG_SIZE; i++)
+    {
+      memcpy(reply + replyLen, &log.records[i].uptimeMs, 4);
+      replyLen += 4;
+      reply[replyLen++] = log.records[i].code;
+      reply[replyLen++] = log.records[i].pumpsRunning;
+    }
+    break;
+  }
+  case COMMAND_READ_DOSES:
+  {
+    if (len != 1)
+    {
+      status = COMMAND_BAD_REQUEST;
+      break;
+    }
+    DoseRecord record;
+    uint8_t count = loadDose(payload[0], &record);
+    reply[replyLen++] = count;
+    if (payload[0] >= count)
+    {
+      break;
+    }
+    // Field by field, as for the faults
+    memcpy(reply + replyLen, &record.uptimeMs, 4);
+    replyLen += 4;
+    memcpy(reply + replyLen, &record.seconds, 2);
+    replyLen += 2;
+    memcpy(reply + replyLen, &record.ml, 2);
+    replyLen += 2;
+    reply[replyLen++] = record.pump;
+    break;
+  }
+  default:
+    status = COMMAND_BAD_REQUEST;
+    break;
+  }
+
+  telemetryReply(type, status, reply, replyLen);
+}
@@ -8,10 +8,89 @@ int clamp(int amt, int low, int high, int step, int def) {
   return amt % step == 0 ? clamp(amt, low, high) : def;
 }
 
+bool inRange(int amt, int low, int high) {
+  return amt >= low && amt <= high;
+}
+
+bool inRange(int amt, int low, int high, int step) {
+  return amt % step == 0 && inRange(amt, low, high);
+}
+
+static EEPROM_MEM defaultConfig()
+{
+  EEPROM_MEM mem;
+  PumpConfig config = {DEFAULT_FREQUENCY, DEFAULT_SECONDS_PUMP, DEFAULT_PUMP_POWER, DEFAULT_SOIL_SENSOR, DEFAULT_LIGHT_SENSOR, DEFAULT_PUMP_MODE, 0, DEFAULT_DOSE_ML, DEFAULT_FLOW_UL_PER_PULSE};
+  mem.magic = EEPROM_MEM_MAGIC;
+  mem.version = EEPROM_MEM_VERSION;
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    mem.pumpConfigs[i] = config;
+    mem.sensorConfig.soilSensorDryValue[i] = DEFAULT_SOIL_SENSOR_DRY_VALUE;
+    mem.sensorConfig.soilSensorWetValue[i] = DEFAULT_SOIL_SENSOR_WET_VALUE;
+  }
+  mem.sensorConfig.lightSensorDayValue = DEFAULT_LIGHT_SENSOR_DAY_VALUE;
+  mem.sensorConfig.lightSensorNightValue = DEFAULT_LIGHT_SENSOR_NIGHT_VALUE;
+  return mem;
+}
+
+/**
+ * The image in the EEPROM converted to the current layout, the defaults if it's blank.
+ */
+static EEPROM_MEM migrateConfig()
+{
+  EEPROM_MEM mem = defaultConfig();
+  EEPROM_MEM_V1 v1;
+  EEPROM.readBlock(0, v1);
+  if (v1.magic == EEPROM_MEM_MAGIC && v1.version == 1)
+  {
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      PumpConfig *config = &mem.pumpConfigs[i];
+      config->frequency = v1.pumpConfigs[i].frequency;
+      config->secondsPump = v1.pumpConfigs[i].secondsPump;
+      config->power = v1.pumpConfigs[i].power;
+      config->soilSensor = v1.pumpConfigs[i].soilSensor;
+      config->lightSensor = v1.pumpConfigs[i].lightSensor;
+      config->mode = v1.pumpConfigs[i].mode;
+      config->doseGain = v1.pumpConfigs[i].doseGain;
+    }
+    mem.sensorConfig = v1.sensorConfig;
+    return mem;
+  }
+
+  EEPROM_MEM_V0 v0;
+  EEPROM.readBlock(0, v0);
+  // No header to tell, but a blank EEPROM reads -1: only keep an image with every frequency in range
+  // (a frequency of 90 reads as the magic, with version 0)
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    if (!inRange(v0.pumpConfigs[i].frequency, MIN_FREQUENCY, MAX_FREQUENCY, STEPS_FREQUENCY))
+    {
+      return mem;
+    }
+  }
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    PumpConfig *config = &mem.pumpConfigs[i];
+    config->frequency = v0.pumpConfigs[i].frequency;
+    config->secondsPump = v0.pumpConfigs[i].secondsPump;
+    config->power = v0.pumpConfigs[i].power;
+    config->soilSensor = v0.pumpConfigs[i].soilSensor;
+    config->lightSensor = v0.pumpConfigs[i].lightSensor;
+  }
+  mem.sensorConfig = v0.sensorConfig;
+  return mem;
+}
+
 void loadEEPROM(Pump* pumps, uint8_t pumpsCount, SensorConfig* sensorConfig)
 {
   EEPROM_MEM mem;
   EEPROM.readBlock(0, mem);
+  if (mem.magic != EEPROM_MEM_MAGIC || mem.version != EEPROM_MEM_VERSION)
+  {
+    mem = migrateConfig();
+    EEPROM.updateBlock(0, mem);
+  }
   for (uint8_t i = 0; i < pumpsCount; i++)
   {
     PumpConfig menConfig = mem.pumpConfigs[i];
@@ -21,6 +100,9 @@ void loadEEPROM(Pump* pumps, uint8_t pumpsCount, SensorConfig* sensorConfig)
     menConfig.power = clamp(menConfig.power, MIN_PUMP_POWER, MAX_PUMP_POWER, STEPS_PUMP_POWER, DEFAULT_PUMP_POWER);
     menConfig.soilSensor = clamp(menConfig.soilSensor, MIN_SOIL_SENSOR, MAX_SOIL_SENSOR, STEPS_SOIL_SENSOR, DEFAULT_SOIL_SENSOR);
     menConfig.lightSensor = clamp(menConfig.lightSensor, MIN_LIGHT_SENSOR, MAX_LIGHT_SENSOR, STEPS_LIGHT_SENSOR, DEFAULT_LIGHT_SENSOR);
+    menConfig.mode = clamp(menConfig.mode, MIN_PUMP_MODE, MAX_PUMP_MODE, 1, DEFAULT_PUMP_MODE);
+    menConfig.doseMl = clamp(menConfig.doseMl, MIN_DOSE_ML, MAX_DOSE_ML, STEPS_DOSE_ML, DEFAULT_DOSE_ML);
+    menConfig.flowUlPerPulse = clamp(menConfig.flowUlPerPulse, MIN_FLOW_UL_PER_PULSE, MAX_FLOW_UL_PER_PULSE, 1, DEFAULT_FLOW_UL_PER_PULSE);
     pumps[i].setConfig(menConfig);
   }
 
@@ -43,11 +125,218 @@ void saveEEPROM(Pump* pumps, uint8_t pumpsCount, SensorConfig sensorConfig)
     mem.pumpConfigs[i] = pump->getConfig();
     pump->setLastRunMs(0ul);
   }
+  mem.magic = EEPROM_MEM_MAGIC;
+  mem.version = EEPROM_MEM_VERSION;
   mem.sensorConfig = sensorConfig;
 
   EEPROM.updateBlock(0, mem);
 }
 
+bool validateConfig(EEPROM_MEM mem, uint8_t pumpsCount)
+{
+  if (mem.magic != EEPROM_MEM_MAGIC || mem.version != EEPROM_MEM_VERSION)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < pumpsCount; i++)
+  {
+    PumpConfig config = mem.pumpConfigs[i];
+    if (!inRange(config.frequency, MIN_FREQUENCY, MAX_FREQUENCY, STEPS_FREQUENCY) ||
+        !inRange(config.secondsPump, MIN_SECONDS_PUMP, MAX_SECONDS_PUMP, STEPS_SECONDS_PUMP) ||
+        !inRange(config.power, MIN_PUMP_POWER, MAX_PUMP_POWER, STEPS_PUMP_POWER) ||
+        !inRange(config.soilSensor, MIN_SOIL_SENSOR, MAX_SOIL_SENSOR, STEPS_SOIL_SENSOR) ||
+        !inRange(config.lightSensor, MIN_LIGHT_SENSOR, MAX_LIGHT_SENSOR, STEPS_LIGHT_SENSOR) ||
+        !inRange(config.mode, MIN_PUMP_MODE, MAX_PUMP_MODE) ||
+        !inRange(config.doseMl, MIN_DOSE_ML, MAX_DOSE_ML, STEPS_DOSE_ML) ||
+        !inRange(config.flowUlPerPulse, MIN_FLOW_UL_PER_PULSE, MAX_FLOW_UL_PER_PULSE))
+    {
+      return false;
+    }
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (!inRange(mem.sensorConfig.soilSensorDryValue[i], MIN_SOIL_SENSOR_CALIBRATION, MAX_SOIL_SENSOR_CALIBRATION) ||
+        !inRange(mem.sensorConfig.soilSensorWetValue[i], MIN_SOIL_SENSOR_CALIBRATION, MAX_SOIL_SENSOR_CALIBRATION))
+    {
+      return false;
+    }
+  }
+  return inRange(mem.sensorConfig.lightSensorDayValue, MIN_LIGHT_SENSOR_CALIBRATION, MAX_LIGHT_SENSOR_CALIBRATION) &&
+         inRange(mem.sensorConfig.lightSensorNightValue, MIN_LIGHT_SENSOR_CALIBRATION, MAX_LIGHT_SENSOR_CALIBRATION);
+}
+
+EEPROM_MEM currentConfig(Pump* pumps, uint8_t pumpsCount, SensorConfig sensorConfig)
+{
+  EEPROM_MEM mem;
+  EEPROM.readBlock(0, mem);
+  for (uint8_t i = 0; i < pumpsCount; i++)
+  {
+    mem.pumpConfigs[i] = pumps[i].getConfig();
+  }
+  mem.magic = EEPROM_MEM_MAGIC;
+  mem.version = EEPROM_MEM_VERSION;
+  mem.sensorConfig = sensorConfig;
+  return mem;
+}
+
+void saveDoseGain(uint8_t pumpIdx, uint8_t doseGain)
+{
+  int address = offsetof(EEPROM_MEM, pumpConfigs) + pumpIdx * sizeof(PumpConfig) + offsetof(PumpConfig, doseGain);
+  EEPROM.updateByte(address, doseGain);
+}
+
+void loadHistory(History* history)
+{
+  EEPROM.readBlock(EEPROM_HISTORY_ADDR, *history);
+  if (!historyIsValid(history))
+  {
+    historyClear(history);
+  }
+}
+
+void saveHistory(const History* history)
+{
+  EEPROM.updateBlock(EEPROM_HISTORY_ADDR, *history);
+}
+
+void loadFaultLog(FaultLog* log)
+{
+  EEPROM.readBlock(EEPROM_FAULTS_ADDR, *log);
+  if (log->magic != FAULT_LOG_MAGIC || log->next >= FAULT_LOG_SIZE)
+  {
+    memset(log, 0, sizeof(FaultLog));
+    log->magic = FAULT_LOG_MAGIC;
+  }
+}
+
+static int soilCurveAddress(uint8_t probe)
+{
+  return EEPROM_CURVES_ADDR + offsetof(SoilCurves, knots) + probe * SOIL_CURVE_KNOTS;
+}
+
+uint8_t loadSoilCurves()
+{
+  SoilCurves curves;
+  EEPROM.readBlock(EEPROM_CURVES_ADDR, curves);
+  if (curves.magic != SOIL_CURVE_MAGIC)
+  {
+    return 0;
+  }
+  uint8_t custom = curves.custom;
+  for (uint8_t i = 0; i < SOIL_CURVE_PROBES; i++)
+  {
+    if (!soilCurveIsValid(curves.knots[i]))
+    {
+      custom &= ~(1 << i);
+    }
+  }
+  return custom & ((1 << SOIL_CURVE_PROBES) - 1);
+}
+
+void saveSoilCurvesCustom(uint8_t custom)
+{
+  EEPROM.updateByte(EEPROM_CURVES_ADDR + offsetof(SoilCurves, custom), custom);
+  EEPROM.updateByte(EEPROM_CURVES_ADDR + offsetof(SoilCurves, magic), SOIL_CURVE_MAGIC);
+}
+
+void readSoilCurve(uint8_t probe, uint8_t* knots)
+{
+  EEPROM.readBlock(soilCurveAddress(probe), knots, SOIL_CURVE_KNOTS);
+}
+
+void saveSoilCurve(uint8_t probe, const uint8_t* knots)
+{
+  EEPROM.updateBlock(soilCurveAddress(probe), knots, SOIL_CURVE_KNOTS);
+  // The other probes keep their saved state, whatever was recalibrated since
+  uint8_t custom = loadSoilCurves() | (1 << probe);
+  saveSoilCurvesCustom(custom);
+}
+
+uint8_t evalSoilCurve(uint8_t probe, uint16_t raw)
+{
+  int address = soilCurveAddress(probe) + soilCurveSegment(raw);
+  return soilCurveInterpolate(EEPROM.readByte(address), EEPROM.readByte(address + 1), raw);
+}
+
+void logFault(uint8_t code, uint32_t uptimeMs, uint8_t pumpsRunning)
+{
+  FaultLog log;
+  loadFaultLog(&log);
+  FaultRecord* record = &log.records[log.next];
+  record->uptimeMs = uptimeMs;
+  record->code = code;
+  record->pumpsRunning = pumpsRunning;
+  log.next = (log.next + 1) % FAULT_LOG_SIZE;
+  if (log.total < 255)
+  {
+    log.total++;
+  }
+  EEPROM.updateBlock(EEPROM_FAULTS_ADDR, log);
+}
+
+static uint16_t doseAddress(uint8_t slot)
+{
+  return EEPROM_DOSES_ADDR + slot * sizeof(DoseRecord);
+}
+
+/**
+ * Slot the next run goes to: the first free one, or the one after the newest record.
+ */
+static uint8_t nextDoseSlot(uint8_t* count)
+{
+  DoseRecord record;
+  DoseRecord next;
+  EEPROM.readBlock(doseAddress(0), next);
+  for (uint8_t slot = 0; slot < DOSE_LOG_SIZE; slot++)
+  {
+    record = next;
+    if (record.pump == DOSE_EMPTY)
+    {
+      *count = slot;
+      return slot;
+    }
+    EEPROM.readBlock(doseAddress((slot + 1) % DOSE_LOG_SIZE), next);
+    if (next.pump == DOSE_EMPTY || next.seq != (uint8_t)(record.seq + 1))
+    {
+      *count = next.pump == DOSE_EMPTY ? slot + 1 : DOSE_LOG_SIZE;
+      return (slot + 1) % DOSE_LOG_SIZE;
+    }
+  }
+  *count = DOSE_LOG_SIZE;
+  return 0;
+}
+
+void logDose(uint8_t pumpIdx, uint32_t uptimeMs, uint16_t seconds, uint16_t ml)
+{
+  uint8_t count;
+  uint8_t slot = nextDoseSlot(&count);
+  DoseRecord record;
+  record.seq = 0;
+  if (count > 0)
+  {
+    EEPROM.readBlock(doseAddress((slot + DOSE_LOG_SIZE - 1) % DOSE_LOG_SIZE), record);
+    record.seq++;
+  }
+  record.uptimeMs = uptimeMs;
+  record.seconds = seconds;
+  record.ml = ml;
+  record.pump = pumpIdx;
+  EEPROM.updateBlock(doseAddress(slot), record);
+}
+
+uint8_t loadDose(uint8_t idx, DoseRecord* record)
+{
+  uint8_t count;
+  uint8_t slot = nextDoseSlot(&count);
+  if (idx < count)
+  {
+    // The oldest is at 0 until the ring is full, then where the next one goes
+    uint8_t oldest = count < DOSE_LOG_SIZE ? 0 : slot;
+    EEPROM.readBlock(doseAddress((oldest + idx) % DOSE_LOG_SIZE), *record);
+  }
+  return count;
+}
+
 int filterNoise(int lastMeasure, int newMeasure)
 {
   if (lastMeasure == 0)
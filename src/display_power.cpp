@@ -0,0 +1,43 @@
+#include "display_power.h"
+
+void displayPowerBegin(DisplayPowerManager* manager, Adafruit_SSD1306* display)
+{
+  manager->display = display;
+  manager->state = DISPLAY_ON;
+}
+
+static void setContrast(DisplayPowerManager* manager, uint8_t contrast)
+{
+  manager->display->ssd1306_command(SSD1306_SETCONTRAST);
+  manager->display->ssd1306_command(contrast);
+}
+
+void displayPowerUpdate(DisplayPowerManager* manager, uint32_t idleMs)
+{
+  DisplayPower state = idleMs >= DISPLAY_DIM_MS ? DISPLAY_DIMMED : DISPLAY_ON;
+  if (state == manager->state)
+  {
+    return;
+  }
+  if (manager->state == DISPLAY_OFF)
+  {
+    // Charge pump first, the panel runs from it
+    manager->display->ssd1306_command(SSD1306_CHARGEPUMP);
+    manager->display->ssd1306_command(0x14);
+    manager->display->ssd1306_command(SSD1306_DISPLAYON);
+  }
+  setContrast(manager, state == DISPLAY_DIMMED ? DISPLAY_CONTRAST_DIM : DISPLAY_CONTRAST_NORMAL);
+  manager->state = state;
+}
+
+void displayPowerOff(DisplayPowerManager* manager)
+{
+  if (manager->state == DISPLAY_OFF)
+  {
+    return;
+  }
+  manager->display->ssd1306_command(SSD1306_DISPLAYOFF);
+  manager->display->ssd1306_command(SSD1306_CHARGEPUMP);
+  manager->display->ssd1306_command(0x10);
+  manager->state = DISPLAY_OFF;
+}
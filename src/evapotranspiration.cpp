@@ -0,0 +1,45 @@
+#include "evapotranspiration.h"
+
+// Saturation vapour pressure in Pa, from ET_MIN_TEMPERATURE to ET_MAX_TEMPERATURE
+const uint16_t saturationPressure[] PROGMEM = {
+    611, 657, 706, 758, 813, 872, 935, 1002,
+    1073, 1148, 1228, 1313, 1403, 1498, 1599, 1705,
+    1818, 1938, 2064, 2197, 2338, 2487, 2644, 2809,
+    2984, 3168, 3361, 3565, 3780, 4006, 4243, 4492,
+    4755, 5030, 5319, 5622, 5941, 6275, 6625, 6991,
+    7375, 7778, 8199, 8639, 9100, 9582};
+
+uint16_t vapourPressureDeficit(int8_t temperature, uint8_t humidity)
+{
+  temperature = constrain(temperature, ET_MIN_TEMPERATURE, ET_MAX_TEMPERATURE);
+  humidity = constrain(humidity, 0, 100);
+  uint16_t saturation = pgm_read_word(&saturationPressure[temperature - ET_MIN_TEMPERATURE]);
+  return ((uint32_t)saturation * (100 - humidity)) / 100;
+}
+
+uint16_t evapotranspirationFactor(int8_t temperature, uint8_t humidity, uint8_t light)
+{
+  uint16_t lightWeight = ET_LIGHT_BASE + ((ET_FACTOR_ONE - ET_LIGHT_BASE) * (uint16_t)constrain(light, 0, 100)) / 100;
+  uint32_t factor = ((uint32_t)vapourPressureDeficit(temperature, humidity) * lightWeight) / ET_REFERENCE_VPD;
+  return constrain(factor, (uint32_t)ET_FACTOR_MIN, (uint32_t)ET_FACTOR_MAX);
+}
+
+uint16_t evapotranspirationScale(int8_t temperature, uint8_t humidity, uint8_t light)
+{
+  // Integer square root of factor * ET_FACTOR_ONE, bit by bit
+  uint32_t value = (uint32_t)evapotranspirationFactor(temperature, humidity, light) * ET_FACTOR_ONE;
+  uint32_t root = 0;
+  for (uint32_t bit = 1ul << 18; bit > 0; bit >>= 2)
+  {
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+  }
+  return root;
+}
@@ -0,0 +1,52 @@
+#include "flow_meter.h"
+
+void flowMetersBegin(FlowMeters* meters, volatile uint8_t* pin)
+{
+  meters->pin = pin;
+  meters->count = 0;
+  meters->lastState = *pin;
+  for (uint8_t i = 0; i < FLOW_MAX_METERS; i++)
+  {
+    meters->masks[i] = 0;
+    meters->pulses[i] = 0;
+  }
+}
+
+void flowMetersAdd(FlowMeters* meters, uint8_t mask)
+{
+  if (meters->count == FLOW_MAX_METERS)
+  {
+    return;
+  }
+  meters->masks[meters->count++] = mask;
+  meters->lastState = *meters->pin;
+}
+
+void flowMetersOnPinChange(FlowMeters* meters)
+{
+  uint8_t state = *meters->pin;
+  uint8_t rising = state & ~meters->lastState;
+  meters->lastState = state;
+  for (uint8_t i = 0; i < meters->count; i++)
+  {
+    if (rising & meters->masks[i])
+    {
+      meters->pulses[i]++;
+    }
+  }
+}
+
+uint16_t flowMetersPulses(FlowMeters* meters, uint8_t idx)
+{
+  noInterrupts();
+  uint16_t pulses = meters->pulses[idx];
+  interrupts();
+  return pulses;
+}
+
+void flowMetersReset(FlowMeters* meters, uint8_t idx)
+{
+  noInterrupts();
+  meters->pulses[idx] = 0;
+  interrupts();
+}
@@ -0,0 +1,64 @@
+#include "framing.h"
+
+uint16_t crc16Update(uint16_t crc, uint8_t data)
+{
+  crc ^= (uint16_t)data << 8;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint16_t cobsEncode(const uint8_t* in, uint16_t len, uint8_t* out)
+{
+  uint16_t codeIdx = 0;
+  uint16_t outIdx = 1;
+  uint8_t code = 1;
+  for (uint16_t i = 0; i < len; i++)
+  {
+    if (in[i] == 0)
+    {
+      out[codeIdx] = code;
+      codeIdx = outIdx++;
+      code = 1;
+    }
+    else
+    {
+      out[outIdx++] = in[i];
+      code++;
+      // A block holds at most 254 bytes, the next one starts without an implied zero
+      if (code == 0xFF && i + 1 < len)
+      {
+        out[codeIdx] = code;
+        codeIdx = outIdx++;
+        code = 1;
+      }
+    }
+  }
+  out[codeIdx] = code;
+  return outIdx;
+}
+
+uint16_t cobsDecode(uint8_t* buf, uint16_t len)
+{
+  uint16_t inIdx = 0;
+  uint16_t outIdx = 0;
+  while (inIdx < len)
+  {
+    uint8_t code = buf[inIdx++];
+    if (code == 0 || inIdx + code - 1 > len)
+    {
+      return 0;
+    }
+    for (uint8_t i = 1; i < code; i++)
+    {
+      buf[outIdx++] = buf[inIdx++];
+    }
+    if (code < 0xFF && inIdx < len)
+    {
+      buf[outIdx++] = 0;
+    }
+  }
+  return outIdx;
+}
@@ -0,0 +1,116 @@
+#include "history.h"
+
+#define DELTA_MIN -8
+#define DELTA_MAX 7
+
+static int16_t constrainDelta(int16_t delta)
+{
+  return delta < DELTA_MIN ? DELTA_MIN : (delta > DELTA_MAX ? DELTA_MAX : delta);
+}
+
+static int8_t getDelta(const HistoryChannel* channel, uint8_t idx)
+{
+  uint8_t nibble = channel->deltas[idx >> 1];
+  nibble = (idx & 1) ? nibble >> 4 : nibble & 0x0F;
+  // Sign extend the 4 bits
+  return (int8_t)(nibble << 4) >> 4;
+}
+
+static void setDelta(HistoryChannel* channel, uint8_t idx, int8_t delta)
+{
+  uint8_t* byte = &channel->deltas[idx >> 1];
+  if (idx & 1)
+  {
+    *byte = (*byte & 0x0F) | ((delta & 0x0F) << 4);
+  }
+  else
+  {
+    *byte = (*byte & 0xF0) | (delta & 0x0F);
+  }
+}
+
+void historyClear(History* history)
+{
+  history->magic = HISTORY_MAGIC;
+  history->head = 0;
+  history->count = 0;
+  for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+  {
+    history->channels[i].base = 0;
+    history->channels[i].last = 0;
+  }
+}
+
+bool historyIsValid(const History* history)
+{
+  return history->magic == HISTORY_MAGIC && history->head < HISTORY_SAMPLES && history->count <= HISTORY_SAMPLES + 1;
+}
+
+void historyPush(History* history, const uint8_t values[HISTORY_CHANNELS])
+{
+  if (history->count == 0)
+  {
+    for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+    {
+      history->channels[i].base = values[i];
+      history->channels[i].last = values[i];
+    }
+    history->count = 1;
+    return;
+  }
+
+  bool full = history->count == HISTORY_SAMPLES + 1;
+  uint8_t idx = (history->head + history->count - 1) % HISTORY_SAMPLES;
+
+  for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+  {
+    HistoryChannel* channel = &history->channels[i];
+    if (full)
+    {
+      // The oldest delta moves into the base before being overwritten
+      channel->base += getDelta(channel, history->head) * (1 << HISTORY_DELTA_SHIFT);
+    }
+
+    // Delta from what the decoder has, so the rounding errors don't add up
+    int16_t diff = (int16_t)values[i] - channel->last;
+    int16_t half = (1 << HISTORY_DELTA_SHIFT) >> 1;
+    int16_t delta = (diff >= 0 ? diff + half : diff - half) / (1 << HISTORY_DELTA_SHIFT);
+    delta = constrainDelta(delta);
+    // Don't step out of 0-255 when the value is at the edges, go as close as a step allows
+    int16_t next = channel->last + delta * (1 << HISTORY_DELTA_SHIFT);
+    if (next < 0)
+    {
+      delta = -(channel->last / (1 << HISTORY_DELTA_SHIFT));
+    }
+    else if (next > 255)
+    {
+      delta = (255 - channel->last) / (1 << HISTORY_DELTA_SHIFT);
+    }
+    channel->last += delta * (1 << HISTORY_DELTA_SHIFT);
+    setDelta(channel, idx, delta);
+  }
+
+  if (full)
+  {
+    history->head = (history->head + 1) % HISTORY_SAMPLES;
+  }
+  else
+  {
+    history->count++;
+  }
+}
+
+uint8_t historyRead(const History* history, uint8_t channel, uint8_t* out)
+{
+  const HistoryChannel* ch = &history->channels[channel];
+  uint8_t value = ch->base;
+  for (uint8_t i = 0; i < history->count; i++)
+  {
+    if (i > 0)
+    {
+      value += getDelta(ch, (history->head + i - 1) % HISTORY_SAMPLES) * (1 << HISTORY_DELTA_SHIFT);
+    }
+    out[i] = value;
+  }
+  return history->count;
+}
@@ -0,0 +1,60 @@
+#include "leak_guard.h"
+
+void leakGuardBegin(LeakGuard* guard, volatile uint8_t* sensorPin, uint8_t sensorMask)
+{
+  guard->sensorPin = sensorPin;
+  guard->sensorMask = sensorMask;
+  guard->outputsCount = 0;
+  guard->tripped = false;
+}
+
+void leakGuardAddOutput(LeakGuard* guard, volatile uint8_t* port, uint8_t mask, volatile uint8_t* tccr, uint8_t comMask)
+{
+  if (guard->outputsCount == LEAK_MAX_OUTPUTS)
+  {
+    return;
+  }
+  LeakOutput* output = &guard->outputs[guard->outputsCount++];
+  output->port = port;
+  output->mask = mask;
+  output->tccr = tccr;
+  output->comMask = comMask;
+}
+
+bool leakGuardIsWet(const LeakGuard* guard)
+{
+  // Active low: the probe shorts the pulled up pin to ground
+  return (*guard->sensorPin & guard->sensorMask) == 0;
+}
+
+void leakGuardCut(LeakGuard* guard)
+{
+  for (uint8_t i = 0; i < guard->outputsCount; i++)
+  {
+    LeakOutput* output = &guard->outputs[i];
+    if (output->tccr)
+    {
+      *output->tccr &= ~output->comMask;
+    }
+    *output->port &= ~output->mask;
+  }
+}
+
+void leakGuardCheck(LeakGuard* guard)
+{
+  if (leakGuardIsWet(guard))
+  {
+    leakGuardCut(guard);
+    guard->tripped = true;
+  }
+}
+
+bool leakGuardAcknowledge(LeakGuard* guard)
+{
+  if (leakGuardIsWet(guard))
+  {
+    return false;
+  }
+  guard->tripped = false;
+  return true;
+}
@@ -4,21 +4,53 @@
 #include <DHT.h>
 #include <avr/wdt.h>
 #include <avr/sleep.h>
+#include <util/atomic.h>
 
+#include "clock_manager.h"
 #include "configuration.h"
+#include "display_power.h"
 #include "pump.h"
+#include "pump_arbiter.h"
+#include "soft_pwm.h"
 #include "sensor_data.h"
+#include "sensor_sampler.h"
+#include "flow_meter.h"
 #include "images.h"
+#include "leak_guard.h"
+#include "node.h"
+#include "telemetry.h"
+#include "commands.h"
+#include "warm_restart.h"
 
 #define SLEEP
 #define WD
+#define TELEMETRY
+#define HISTORY_EEPROM
+#define SCREEN
+#define LEAK_SENSOR
+#define FLOW_METERS
+#define CLOCK_SCALING
+#define WARM_RESTART
+// Multi-board setup (see node.h), at most one of them:
+// #define NODE 0        // Node id, answers at NODE_I2C_BASE_ADDRESS + id
+// #define COORDINATOR 8 // Number of nodes to poll
+#ifdef NODE
+// Headless, see node.h: the buffer isn't even allocated
+#undef SCREEN
+#endif
+
+#if defined(NODE) || defined(COORDINATOR)
+// The bus keeps the full clock, as it keeps the unit awake
+#undef CLOCK_SCALING
+#endif
 
 #define SCREEN_WIDTH 128 // OLED display width, in pixels
 #define SCREEN_HEIGHT 64 // OLED display height, in pixels
 
 #define SLEEP_TIME 1000 * 15
 
-#define NUM_PUMPS 3
+// Save the history to the EEPROM every N samples
+#define HISTORY_EEPROM_EVERY 4
 
 /**
   TEMPERATURE AND HUMIDITY SENSOR
@@ -36,6 +68,23 @@
 #define SOIL_SENSOR_02 A1
 #define SOIL_SENSOR_03 A2
 
+// Powers the soil sensors and the light sensor, only while sampling.
+// Off the ISP lines (11-13): an output there would fight the programmer.
+#define SENSOR_POWER_PIN 9
+
+// Float switch / leak probe to ground, cuts the pumps when wet
+#define LEAK_SENSOR_PIN 10 // PB2 PCINT2
+
+// Hall effect flow meter of each pump, on the same port as the leak probe.
+// The LED of pin 13 loads the line: the meter needs a push-pull output or a strong pull-up there.
+// 11-13 are also the ISP lines (MOSI, MISO, SCK): the meters would fight the programmer.
+#define FLOW_METER_01 12 // PB4 PCINT4
+#define FLOW_METER_02 11 // PB3 PCINT3
+#define FLOW_METER_03 13 // PB5 PCINT5
+#if defined(FLOW_METERS) && defined(ISP_UPLOAD)
+#error "The flow meters take the ISP lines (11-13): upload through the bootloader or disable FLOW_METERS"
+#endif
+
 /**
   BUTTONS PINS
 */
@@ -44,7 +93,7 @@
 #define BTN_3 5 // PD5 PCINT21
 
 /** PUMPS **/
-#define PUMP_01 6
+#define PUMP_01 6 // PWM, the others are on/off so their soft start is just a delayed start
 #define PUMP_02 7
 #define PUMP_03 8
 
@@ -53,8 +102,9 @@
 */
 enum AppState
 {
-  HOME,    // Show the home screen
-  SETTINGS // Show the Settings screen
+  HOME,     // Show the home screen
+  TREND,    // Show the soil moisture history of the pump
+  SETTINGS  // Show the Settings screen
 };
 
 /**
@@ -67,6 +117,8 @@ enum SettingsState
   PUMP_POWER,
   SOIL_SENSOR_SET,
   LIGHT_SENSOR_SET,
+  DOSE_MODE,
+  DOSE_VOLUME,
   CALIBRATE_SOIL_SENSOR,
   SAVE,
   CALIBRATE_LIGHT_SENSOR
@@ -86,20 +138,65 @@ Pump pumps[NUM_PUMPS] = {
     Pump(PUMP_02),
     Pump(PUMP_03),
 };
-// List of Soil sensors
-const uint8_t soilSensorsPins[NUM_PUMPS] = {
+// List of the sampled sensors: Soil sensors, then the light sensor
+const uint8_t sensorsPins[NUM_PUMPS + 1] = {
   SOIL_SENSOR_01,
   SOIL_SENSOR_02,
   SOIL_SENSOR_03,
+  LIGHT_SENSOR,
 };
+#define SAMPLE_LIGHT NUM_PUMPS
+SensorSampler sampler;
+// Starts waiting for the power budget
+PumpArbiter arbiter;
+
+#ifdef LEAK_SENSOR
+LeakGuard leakGuard;
+// The latched leak was logged and the pumps stopped
+bool leakHandled = false;
+#endif
+
+#ifdef FLOW_METERS
+const uint8_t flowMetersPins[NUM_PUMPS] = {
+  FLOW_METER_01,
+  FLOW_METER_02,
+  FLOW_METER_03,
+};
+// Counted by the pin change interrupt, reset when the pump starts
+FlowMeters flowMeters;
+#endif
 
 boolean sleeping = false;
 
+// UART and ADC settings for the full clock, then the slow one
+const ClockTiming clockTimings[2] = {
+  clockTiming(0, TELEMETRY_BAUD),
+  clockTiming(CLOCK_SLOW_SHIFT, TELEMETRY_BAUD),
+};
+ClockManager clockManager;
+
 /**
   Sensor information
 */
 SensorData sensorData;
 SensorConfig sensorConfig;
+// Probes with their own curve in the EEPROM (see soil_curve.h), the others map between their dry and wet values
+uint8_t soilCurvesCustom = 0;
+#ifdef HISTORY_EEPROM
+// The history lives in the EEPROM, the samples since the last save wait here
+uint8_t historyPending[HISTORY_EEPROM_EVERY][HISTORY_CHANNELS];
+uint8_t historyPendingCount = 0;
+#else
+History history;
+#endif
+
+#ifdef WARM_RESTART
+// Left alone by the C runtime at reset, see warm_restart.h
+WarmState warmState __attribute__((section(".noinit")));
+// Uptime when the state was restored
+uint32_t warmRestoredMs = 0;
+bool warmBooted = false;
+#endif
 
 /**
  * Avoid interference at the buttons when clicked - debounce them
@@ -115,12 +212,57 @@ uint32_t lastDebounceTimeMs = 0;
 */
 // Initialize display
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
+DisplayPowerManager displayPower;
+// A button was pressed, set by the pin change interrupt
+volatile bool buttonWoke = false;
 
 // Initialize temperature and humidity sensor
 DHT dht(DHTPIN, DHTTYPE);
 
 char lineBuffer[22];
 
+#ifdef NODE
+NodeRegisters nodeRegisters;
+// Register the coordinator is reading/writing
+volatile uint8_t nodeRegister = 0;
+// The config registers were written and not committed yet
+volatile bool nodeConfigStaged = false;
+// Set by the I2C handlers: the coordinator is alive
+volatile bool nodeContacted = false;
+uint32_t nodeLastContactMs = 0;
+#endif
+
+#ifdef COORDINATOR
+Coordinator coordinator;
+#endif
+
+/**
+  A latched fault stops the scheduling until it's acknowledged.
+  */
+bool faultActive()
+{
+#ifdef LEAK_SENSOR
+  return leakGuard.tripped;
+#else
+  return false;
+#endif
+}
+
+/**
+  Acknowledge the latched fault. Returns false if its cause is still there.
+  */
+bool acknowledgeFault()
+{
+#ifdef LEAK_SENSOR
+  if (!leakGuardAcknowledge(&leakGuard))
+  {
+    return false;
+  }
+  leakHandled = false;
+#endif
+  return true;
+}
+
 bool anyPumpIsRunning()
 {
   for (uint8_t i = 0; i < NUM_PUMPS; i++)
@@ -134,13 +276,90 @@ bool anyPumpIsRunning()
 }
 
 /**
-  Set the state to PUMPING and start the water pump.
+ * Bit i is set if pump i is running
+ */
+uint8_t pumpsRunningMask()
+{
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    if (pumps[i].isRunning())
+    {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+}
+
+/**
+  Slow the CPU clock down, or back to full speed. The frames already queued go out
+  at the old baud rate first.
+  */
+void setClockSlow(bool slow)
+{
+  if (slow == clockManager.slow)
+  {
+    return;
+  }
+#ifdef TELEMETRY
+  Serial.flush();
+#endif
+  clockSetSlow(&clockManager, slow);
+}
+
+/**
+  Start the water pump now, once the arbiter admitted it.
   */
 void startPump(uint8_t pumpIdx)
 {
   Pump *pump = &pumps[pumpIdx];
-  pump->setStartedAtMs(millis());
-  pump->setRunning(true);
+  // The soft start PWM runs at full speed
+  setClockSlow(false);
+#ifdef FLOW_METERS
+  flowMetersReset(&flowMeters, pumpIdx);
+#endif
+  pump->start(clockMillis(&clockManager), sensorData.soilMoisture[pumpIdx]);
+#ifdef TELEMETRY
+  telemetryPumpEvent(clockMillis(&clockManager), pumpIdx, true, 0);
+#endif
+}
+
+/**
+  Water measured by the flow meter since the pump started, 0 without one.
+  */
+uint16_t deliveredMl(uint8_t pumpIdx)
+{
+#ifdef FLOW_METERS
+  return pumps[pumpIdx].pulsesToMl(flowMetersPulses(&flowMeters, pumpIdx));
+#else
+  return 0;
+#endif
+}
+
+/**
+  Flow meter calibration from the water measured (e.g. in a jug) for the last run of the pump,
+  whose pulses are still counted. Returns the new ul per pulse, 0 if it can't be set.
+  */
+uint16_t calibrateFlow(uint8_t pumpIdx, uint16_t ml)
+{
+#ifdef FLOW_METERS
+  uint16_t pulses = flowMetersPulses(&flowMeters, pumpIdx);
+  if (pumps[pumpIdx].isRunning() || pulses == 0)
+  {
+    return 0;
+  }
+  uint32_t ulPerPulse = ((uint32_t)ml * 1000ul + pulses / 2) / pulses;
+  if (ulPerPulse == 0 || ulPerPulse > MAX_FLOW_UL_PER_PULSE)
+  {
+    return 0;
+  }
+  PumpConfig config = pumps[pumpIdx].getConfig();
+  config.flowUlPerPulse = ulPerPulse;
+  pumps[pumpIdx].setConfig(config);
+  return ulPerPulse;
+#else
+  return 0;
+#endif
 }
 
 /**
@@ -149,7 +368,27 @@ void startPump(uint8_t pumpIdx)
 void stopPump(uint8_t pumpIdx)
 {
   Pump *pump = &pumps[pumpIdx];
-  pump->setRunning(false);
+  arbiterCancel(&arbiter, pumpIdx);
+  if (pump->isRunning())
+  {
+    uint16_t ml = deliveredMl(pumpIdx);
+    logDose(pumpIdx, clockMillis(&clockManager), (clockMillis(&clockManager) - pump->getStartedAtMs()) / 1000, ml);
+#ifdef TELEMETRY
+    telemetryPumpEvent(clockMillis(&clockManager), pumpIdx, false, ml);
+#endif
+  }
+  pump->stop(clockMillis(&clockManager));
+}
+
+/**
+  Queue the water pump, it starts when the power budget allows.
+  */
+void requestPump(uint8_t pumpIdx)
+{
+  if (!pumps[pumpIdx].isRunning() && !faultActive())
+  {
+    arbiterRequest(&arbiter, pumpIdx);
+  }
 }
 
 void startAllPumps()
@@ -157,8 +396,8 @@ void startAllPumps()
   for (uint8_t pumpIdx = 0; pumpIdx < NUM_PUMPS; pumpIdx++)
   {
     Pump *pump = &pumps[pumpIdx];
-    pump->setLastRunMs(millis());
-    startPump(pumpIdx);
+    pump->setLastRunMs(clockMillis(&clockManager));
+    requestPump(pumpIdx);
   }
 }
 
@@ -170,27 +409,168 @@ void stopAllPumps()
   }
 }
 
+/**
+  Load the pumps and sensors config, with the soil curves.
+  */
+void loadConfig()
+{
+  loadEEPROM(pumps, NUM_PUMPS, &sensorConfig);
+  soilCurvesCustom = loadSoilCurves();
+}
+
+void saveConfig()
+{
+  saveEEPROM(pumps, NUM_PUMPS, sensorConfig);
+  saveSoilCurvesCustom(soilCurvesCustom);
+}
+
+/**
+  The curve of a probe as it's used now, SOIL_CURVE_KNOTS bytes.
+  */
+void soilCurve(uint8_t idx, uint8_t *knots)
+{
+  if (soilCurvesCustom & (1 << idx))
+  {
+    readSoilCurve(idx, knots);
+  }
+  else
+  {
+    soilCurveLinear(knots, sensorConfig.soilSensorDryValue[idx], sensorConfig.soilSensorWetValue[idx]);
+  }
+}
+
+void setSoilCurve(uint8_t idx, const uint8_t *knots)
+{
+  saveSoilCurve(idx, knots);
+  soilCurvesCustom |= 1 << idx;
+}
+
+/**
+  Back to the line between the dry and wet values of the probe, once they were recalibrated.
+  Saved with the config: until then, a restart goes back to the stored curve.
+  */
+void resetSoilCurve(uint8_t idx)
+{
+  soilCurvesCustom &= ~(1 << idx);
+}
+
+/**
+  Apply a sensor config sent by the host, resetting the curves of the probes recalibrated by it.
+  */
+void setSensorConfig(SensorConfig config)
+{
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    if (config.soilSensorDryValue[i] != sensorConfig.soilSensorDryValue[i] ||
+        config.soilSensorWetValue[i] != sensorConfig.soilSensorWetValue[i])
+    {
+      resetSoilCurve(i);
+    }
+  }
+  sensorConfig = config;
+}
+
+/**
+  Update the sensor data when the sampler has a new batch: fast while someone is
+  around or a pump runs (adaptive dosing follows the moisture), once a minute otherwise.
+  */
 void readSensors()
 {
+  uint32_t intervalMs = SAMPLER_INTERVAL_MS;
+  if (anyPumpIsRunning() || uint32_t(clockMillis(&clockManager) - lastDebounceTimeMs) < SLEEP_TIME)
+  {
+    intervalMs = SAMPLER_ACTIVE_INTERVAL_MS;
+  }
+  if (!samplerUpdate(&sampler, clockMillis(&clockManager), intervalMs))
+  {
+    return;
+  }
+
+  // The DHT bit banging is timed for the full clock
+  bool slow = clockManager.slow;
+  setClockSlow(false);
   sensorData.temperature = int(dht.readTemperature());
   sensorData.humidity = int(dht.readHumidity());
+  setClockSlow(slow);
 
   int sensorRead;
 
-  sensorRead = analogRead(LIGHT_SENSOR);
+  sensorRead = sampler.raw[SAMPLE_LIGHT];
   sensorRead = map(sensorRead, sensorConfig.lightSensorNightValue, sensorConfig.lightSensorDayValue, 0, 100);
   sensorRead = constrain(sensorRead, 0, 100);
   sensorData.light = filterNoise(sensorData.light, sensorRead);
 
   for (uint8_t i = 0; i < NUM_PUMPS; i++)
   {
-    sensorRead = analogRead(soilSensorsPins[i]);
-    sensorRead = map(sensorRead, sensorConfig.soilSensorDryValue[i], sensorConfig.soilSensorWetValue[i], 0, 100);
-    sensorRead = constrain(sensorRead, 0, 100);
+    sensorRead = sampler.raw[i];
+    if (soilCurvesCustom & (1 << i))
+    {
+      sensorRead = evalSoilCurve(i, sensorRead);
+    }
+    else
+    {
+      sensorRead = map(sensorRead, sensorConfig.soilSensorDryValue[i], sensorConfig.soilSensorWetValue[i], 0, 100);
+      sensorRead = constrain(sensorRead, 0, 100);
+    }
     sensorData.soilMoisture[i] = filterNoise(sensorData.soilMoisture[i], sensorRead);
   }
 }
 
+// A fresh batch, to record the probe as it is at the click
+int readSoilSensorRaw(uint8_t pumpIdx)
+{
+  samplerSampleNow(&sampler, clockMillis(&clockManager));
+  return sampler.raw[pumpIdx];
+}
+
+int readLightSensorRaw()
+{
+  samplerSampleNow(&sampler, clockMillis(&clockManager));
+  return sampler.raw[SAMPLE_LIGHT];
+}
+
+#ifdef HISTORY_EEPROM
+/**
+  The history in the EEPROM with the samples not saved yet, in a History on the caller's stack.
+  */
+void loadFullHistory(History *history)
+{
+  loadHistory(history);
+  for (uint8_t i = 0; i < historyPendingCount; i++)
+  {
+    historyPush(history, historyPending[i]);
+  }
+}
+#endif
+
+/**
+  Append the current sensor values to the history.
+  */
+void recordHistory()
+{
+  uint8_t values[HISTORY_CHANNELS];
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    values[HISTORY_SOIL + i] = sensorData.soilMoisture[i];
+  }
+  values[HISTORY_LIGHT] = sensorData.light;
+  values[HISTORY_TEMPERATURE] = sensorData.temperature + HISTORY_TEMPERATURE_OFFSET;
+  values[HISTORY_HUMIDITY] = sensorData.humidity;
+
+#ifdef HISTORY_EEPROM
+  memcpy(historyPending[historyPendingCount++], values, HISTORY_CHANNELS);
+  if (historyPendingCount >= HISTORY_EEPROM_EVERY)
+  {
+    History history;
+    loadFullHistory(&history);
+    saveHistory(&history);
+    historyPendingCount = 0;
+  }
+#else
+  historyPush(&history, values);
+#endif
+}
+
 void printCenterH(const char *text, uint8_t size, int16_t x, int16_t y)
 {
   int16_t x1, y1;
@@ -260,8 +640,8 @@ void body(Pump pump, uint8_t pumpIdx, SensorData sensorData)
     display.setCursor(40, 22);
     display.setTextSize(1);
     display.print(F("...RUNNING..."));
-    uint32_t configPumpMs = ((uint32_t)pumpConfig.secondsPump) * 1000ul;
-    uint32_t elapsedMs = millis() - pump.getStartedAtMs();
+    uint32_t configPumpMs = ((uint32_t)pump.getRunSeconds()) * 1000ul;
+    uint32_t elapsedMs = clockMillis(&clockManager) - pump.getStartedAtMs();
     int secsLeft = int((configPumpMs - elapsedMs) / 1000ul);
     sprintf_P(lineBuffer, PSTR("%03dsecs left"), secsLeft);
     display.setCursor(40, 38);
@@ -270,6 +650,14 @@ void body(Pump pump, uint8_t pumpIdx, SensorData sensorData)
     // display.drawBitmap(107, 24, epd_bitmap_fan, 20, 20, WHITE);
     footer(F(""), F("Cancel"), F("Next"));
   }
+  else if (arbiterIsQueued(&arbiter, pumpIdx))
+  {
+    // Waiting for the other pumps, see pump_arbiter.h
+    display.setCursor(40, 22);
+    display.setTextSize(1);
+    display.print(F("...QUEUED..."));
+    footer(F(""), F("Cancel"), F("Next"));
+  }
   else
   {
     // Light Sensor
@@ -289,7 +677,7 @@ void body(Pump pump, uint8_t pumpIdx, SensorData sensorData)
 
     display.setTextSize(1);
     display.setCursor(40, 35);
-    sprintf_P(lineBuffer, PSTR("%02dh%02dmin"), pump.secondsToNextRun(millis()) / 60 / 60, (pump.secondsToNextRun(millis()) / 60) % 60);
+    sprintf_P(lineBuffer, PSTR("%02dh%02dmin"), pump.secondsToNextRun(clockMillis(&clockManager)) / 60 / 60, (pump.secondsToNextRun(clockMillis(&clockManager)) / 60) % 60);
     display.print(lineBuffer);
     sprintf_P(lineBuffer, PSTR("%03dsecs"), pumpConfig.secondsPump);
     display.setCursor(40, 45);
@@ -322,9 +710,70 @@ void renderHome()
 {
   Pump pump = pumps[pumpIdxHome];
   header(sensorData.temperature, sensorData.humidity, sensorData.light);
+  if (faultActive())
+  {
+    printCenterH(F("LEAK!"), 3, 0, 24);
+    footer(F(""), F("Ack"), F(""));
+    return;
+  }
   body(pump, pumpIdxHome, sensorData);
 }
 
+#define TREND_X 24
+#define TREND_Y 18
+#define TREND_HEIGHT 34
+
+/**
+  Render the soil moisture history of the pump, with its threshold.
+  */
+void renderTrend()
+{
+  PumpConfig pumpConfig = pumps[pumpIdxHome].getConfig();
+  uint8_t values[HISTORY_SAMPLES + 1];
+#ifdef HISTORY_EEPROM
+  History history;
+  loadFullHistory(&history);
+#endif
+  uint8_t size = historyRead(&history, HISTORY_SOIL + pumpIdxHome, values);
+
+  header(sensorData.temperature, sensorData.humidity, sensorData.light);
+
+  display.setTextSize(1);
+  display.setCursor(0, 20);
+  display.print(F("P"));
+  display.print(pumpIdxHome + 1);
+  display.setCursor(0, 30);
+  display.write(0xef);
+
+  // Dotted line at the threshold
+  uint8_t thresholdY = TREND_Y + TREND_HEIGHT - (TREND_HEIGHT * pumpConfig.soilSensor) / 100;
+  for (uint8_t x = TREND_X; x < SCREEN_WIDTH; x += 4)
+  {
+    display.drawPixel(x, thresholdY, WHITE);
+  }
+
+  // Newest sample on the right, 2px per sample
+  uint8_t x0 = TREND_X + (HISTORY_SAMPLES + 1 - size) * 2;
+  for (uint8_t i = 1; i < size; i++)
+  {
+    display.drawLine(x0 + (i - 1) * 2, TREND_Y + TREND_HEIGHT - (TREND_HEIGHT * min(values[i - 1], 100)) / 100,
+                     x0 + i * 2, TREND_Y + TREND_HEIGHT - (TREND_HEIGHT * min(values[i], 100)) / 100, WHITE);
+  }
+
+  // Change over the last 2h
+  uint8_t back = 120 / HISTORY_INTERVAL_MIN;
+  if (size > back)
+  {
+    display.setCursor(0, 42);
+    sprintf_P(lineBuffer, PSTR("%+d"), (values[size - 1] - values[size - 1 - back]) / 2);
+    display.print(lineBuffer);
+    display.setCursor(0, 50);
+    display.print(F("/h"));
+  }
+
+  footer(F("Home"), F(""), F("Next"));
+}
+
 /**
   Render settings screen. For each SettingsState, render different information.
   */
@@ -378,6 +827,40 @@ void renderSettings()
     printCenterH(lineBuffer, 1, 28, 40);
     footer(F("next"), F("+"), F("-"));
     break;
+  case DOSE_MODE:
+    printCenterH(F("Mode"), 1, 28, 20);
+    if (pump->getConfig().mode & PUMP_MODE_ADAPTIVE)
+    {
+      sprintf_P(lineBuffer, PSTR("Adaptive %d"), pump->getConfig().doseGain);
+      printCenterH(lineBuffer, 1, 28, 30);
+    }
+    else
+    {
+      printCenterH(F("Fixed"), 1, 28, 30);
+    }
+    if (pump->getConfig().mode & PUMP_MODE_ET)
+    {
+      printCenterH(F("+ ET sched."), 1, 28, 40);
+    }
+    footer(F("next"), F("+"), F("-"));
+    break;
+  case DOSE_VOLUME:
+    printCenterH(F("Dose"), 1, 28, 20);
+    if (pump->getConfig().doseMl == 0)
+    {
+      printCenterH(F("By time"), 1, 28, 30);
+    }
+    else
+    {
+      sprintf_P(lineBuffer, PSTR("%4dml"), pump->getConfig().doseMl);
+      printCenterH(lineBuffer, 1, 28, 30);
+    }
+    if (pump->getConfig().flowUlPerPulse == 0)
+    {
+      printCenterH(F("No flow cal."), 1, 28, 40);
+    }
+    footer(F("next"), F("+"), F("-"));
+    break;
   case CALIBRATE_SOIL_SENSOR:
     printCenterH(F("Soil Calib."), 1, 28, 20);
     sprintf_P(lineBuffer, PSTR("Dry: %4d"), sensorConfig.soilSensorDryValue[pumpIdxSettings]);
@@ -417,6 +900,9 @@ void render()
   case HOME:
     renderHome();
     break;
+  case TREND:
+    renderTrend();
+    break;
   case SETTINGS:
     renderSettings();
     break;
@@ -463,14 +949,18 @@ void btn1Press()
     if (settingsState == SAVE)
     {
       // User didn't save. Read again the configuration from EEPROM
-      loadEEPROM(pumps, NUM_PUMPS, &sensorConfig);
+      loadConfig();
     }
     else if (settingsState == CALIBRATE_LIGHT_SENSOR)
     {
-      saveEEPROM(pumps, NUM_PUMPS, sensorConfig);
+      saveConfig();
     }
     rotateSettings();
   }
+  else if (appState == TREND)
+  {
+    appState = HOME;
+  }
   else
   {
     // Start SETTINGS screen
@@ -507,28 +997,42 @@ void btn2Press()
     case LIGHT_SENSOR_SET:
       pump->incLightSensor(true);
       break;
+    case DOSE_MODE:
+      pump->incMode(true);
+      break;
+    case DOSE_VOLUME:
+      pump->incDoseMl(true);
+      break;
     case CALIBRATE_SOIL_SENSOR:
-      sensorConfig.soilSensorDryValue[pumpIdxSettings] = analogRead(soilSensorsPins[pumpIdxSettings]);
+      samplerSampleNow(&sampler, clockMillis(&clockManager));
+      sensorConfig.soilSensorDryValue[pumpIdxSettings] = sampler.raw[pumpIdxSettings];
+      resetSoilCurve(pumpIdxSettings);
       break;
     case CALIBRATE_LIGHT_SENSOR:
-      sensorConfig.lightSensorDayValue = analogRead(LIGHT_SENSOR);
+      samplerSampleNow(&sampler, clockMillis(&clockManager));
+      sensorConfig.lightSensorDayValue = sampler.raw[SAMPLE_LIGHT];
       break;
     case SAVE:
       // User saved the config
-      saveEEPROM(pumps, NUM_PUMPS, sensorConfig);
+      saveConfig();
       rotateSettings();
       break;
     }
   }
   else if (appState == HOME)
   {
-    if (pumps[pumpIdxHome].isRunning())
+    if (faultActive())
+    {
+      // Stays on the fault screen while the probe is wet
+      acknowledgeFault();
+    }
+    else if (pumps[pumpIdxHome].isRunning() || arbiterIsQueued(&arbiter, pumpIdxHome))
     {
       stopPump(pumpIdxHome);
     }
     else
     {
-      startPump(pumpIdxHome);
+      requestPump(pumpIdxHome);
     }
   }
   else
@@ -559,11 +1063,20 @@ void btn3Press()
     case LIGHT_SENSOR_SET:
       pump->incLightSensor(false);
       break;
+    case DOSE_MODE:
+      pump->incMode(false);
+      break;
+    case DOSE_VOLUME:
+      pump->incDoseMl(false);
+      break;
     case CALIBRATE_SOIL_SENSOR:
-      sensorConfig.soilSensorWetValue[pumpIdxSettings] = analogRead(soilSensorsPins[pumpIdxSettings]);
+      samplerSampleNow(&sampler, clockMillis(&clockManager));
+      sensorConfig.soilSensorWetValue[pumpIdxSettings] = sampler.raw[pumpIdxSettings];
+      resetSoilCurve(pumpIdxSettings);
       break;
     case CALIBRATE_LIGHT_SENSOR:
-      sensorConfig.lightSensorNightValue = analogRead(LIGHT_SENSOR);
+      samplerSampleNow(&sampler, clockMillis(&clockManager));
+      sensorConfig.lightSensorNightValue = sampler.raw[SAMPLE_LIGHT];
       break;
     case SAVE:
       appState = HOME;
@@ -572,6 +1085,12 @@ void btn3Press()
   }
   else if (appState == HOME)
   {
+    // Show the trend of the same pump, then move to the next one
+    appState = TREND;
+  }
+  else if (appState == TREND)
+  {
+    appState = HOME;
     pumpIdxHome = (pumpIdxHome + 1) % NUM_PUMPS;
   }
 }
@@ -581,46 +1100,409 @@ void btn3Press()
 */
 void checkSchedule()
 {
+  if (faultActive())
+  {
+    return;
+  }
   for (uint8_t pumpIdx = 0; pumpIdx < NUM_PUMPS; pumpIdx++)
   {
-    Pump *pump = &pumps[pumpIdx];
-    if (!pump->isRunning() && pump->isTimeToRun(millis(), sensorData, pumpIdx))
+#ifdef FLOW_METERS
+    // Volumetric dose delivered, secondsPump is only the safety limit then
+    if (pumps[pumpIdx].isDoseReached(flowMetersPulses(&flowMeters, pumpIdx)))
     {
-      startPump(pumpIdx);
+      stopPump(pumpIdx);
+      continue;
     }
-    else if (pump->isRunning())
+#endif
+#ifdef NODE
+    // The coordinator didn't give us our turn yet
+    if (nodeIsHeld(&nodeRegisters, nodeLastContactMs, clockMillis(&clockManager)) && !pumps[pumpIdx].isRunning())
     {
-      uint32_t pumpMs = (uint32_t)pump->getConfig().secondsPump * 1000ul;
-      if ((uint32_t)(millis() - pump->getStartedAtMs()) >= pumpMs)
-      {
-        stopPump(pumpIdx);
-      }
+      continue;
+    }
+#endif
+    switch (pumps[pumpIdx].checkSchedule(clockMillis(&clockManager), sensorData, pumpIdx))
+    {
+    case PUMP_START:
+      requestPump(pumpIdx);
+      break;
+    case PUMP_STOP:
+      stopPump(pumpIdx);
+      break;
+    case PUMP_GAIN_LEARNED:
+      saveDoseGain(pumpIdx, pumps[pumpIdx].getConfig().doseGain);
+      break;
+    default:
+      break;
     }
   }
 }
 
 /**
-  Run the Pumps in case they are activated
+  Start the queued pumps the power budget allows and drive the running ones, ramping up.
   */
 void runPumps()
 {
-  for (uint8_t pumpIdx = 0; pumpIdx < NUM_PUMPS; pumpIdx++)
+  if (faultActive())
+  {
+    // analogWrite() would connect the PWM again, and the ISR may have hit in the middle
+    // of one in the previous loop: keep them cut
+#ifdef LEAK_SENSOR
+    leakGuardCut(&leakGuard);
+#endif
+    return;
+  }
+  uint8_t pumpIdx;
+  while ((pumpIdx = arbiterNext(&arbiter, pumps, NUM_PUMPS, clockMillis(&clockManager))) != ARBITER_NONE)
+  {
+    startPump(pumpIdx);
+  }
+  for (pumpIdx = 0; pumpIdx < NUM_PUMPS; pumpIdx++)
   {
     Pump *pump = &pumps[pumpIdx];
-    if (pump->isRunning())
+    uint8_t duty = arbiterDuty(pump, clockMillis(&clockManager));
+    // The leak ISR may trip anywhere after the check above: test it again with the
+    // interrupts off, so the write can't connect the PWM again behind its back
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      if (faultActive())
+      {
+        continue;
+      }
+      if (digitalPinToTimer(pump->getPin()) != NOT_ON_TIMER)
+      {
+        analogWrite(pump->getPin(), duty);
+      }
+      else
+      {
+        // 7 and 8, see soft_pwm.h
+        softPwmWrite(pump->getPin(), duty);
+      }
+    }
+  }
+}
+
+#ifdef LEAK_SENSOR
+/**
+  Let the leak guard cut a pump output: its port bit, and the timer driving its PWM.
+  */
+void addLeakOutput(uint8_t pin)
+{
+  volatile uint8_t *tccr = NULL;
+  uint8_t comMask = 0;
+  switch (digitalPinToTimer(pin))
+  {
+  case TIMER0A:
+    tccr = &TCCR0A;
+    comMask = _BV(COM0A1);
+    break;
+  case TIMER0B:
+    tccr = &TCCR0A;
+    comMask = _BV(COM0B1);
+    break;
+  case TIMER1A:
+    tccr = &TCCR1A;
+    comMask = _BV(COM1A1);
+    break;
+  case TIMER1B:
+    tccr = &TCCR1A;
+    comMask = _BV(COM1B1);
+    break;
+  case TIMER2A:
+    tccr = &TCCR2A;
+    comMask = _BV(COM2A1);
+    break;
+  case TIMER2B:
+    tccr = &TCCR2A;
+    comMask = _BV(COM2B1);
+    break;
+  default:
+    // Software PWM (7 and 8, see soft_pwm.h): its overflow would set the pin again
+    tccr = &TIMSK2;
+    comMask = _BV(TOIE2);
+    break;
+  }
+  leakGuardAddOutput(&leakGuard, portOutputRegister(digitalPinToPort(pin)), digitalPinToBitMask(pin), tccr, comMask);
+}
+
+/**
+  The ISR already cut the outputs: stop the pumps, drop the queue and log the fault, once.
+  */
+void handleLeak()
+{
+  // In case the edge came while the interrupts were off
+  leakGuardCheck(&leakGuard);
+  if (!leakGuard.tripped || leakHandled)
+  {
+    return;
+  }
+  leakHandled = true;
+  uint8_t running = pumpsRunningMask();
+  stopAllPumps();
+  logFault(FAULT_LEAK, clockMillis(&clockManager), running);
+#ifdef TELEMETRY
+  telemetryFault(clockMillis(&clockManager), FAULT_LEAK, running);
+#endif
+  // Show it
+  appState = HOME;
+  lastDebounceTimeMs = clockMillis(&clockManager);
+}
+#endif
+
+#ifdef NODE
+/**
+  I2C write from the coordinator: register address, then the data to write there.
+  */
+void nodeReceive(int count)
+{
+  uint8_t buf[NODE_I2C_CHUNK];
+  uint8_t len = 0;
+  if (count < 1)
+  {
+    return;
+  }
+  nodeContacted = true;
+  nodeRegister = Wire.read();
+  while (Wire.available() && len < sizeof(buf))
+  {
+    buf[len++] = Wire.read();
+  }
+  if (nodeWrite(&nodeRegisters, nodeRegister, buf, len))
+  {
+    nodeConfigStaged = true;
+  }
+}
+
+/**
+  I2C read from the coordinator, starting at the last register address written.
+  */
+void nodeRequest()
+{
+  uint8_t buf[NODE_I2C_CHUNK];
+  nodeContacted = true;
+  nodeRead(&nodeRegisters, nodeRegister, buf, sizeof(buf));
+  Wire.write(buf, sizeof(buf));
+}
+
+/**
+  Publish our state in the registers and run the command sent by the coordinator.
+  */
+void updateNode()
+{
+  uint8_t command;
+  uint32_t now = clockMillis(&clockManager);
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    if (nodeContacted)
+    {
+      nodeContacted = false;
+      nodeLastContactMs = now;
+    }
+    // A queued pump is as good as running for the coordinator
+    nodeRegisters.pumpsRunning = pumpsRunningMask() | arbiterQueuedMask(&arbiter);
+    nodeRegisters.pumpsDue = nodeIsHeld(&nodeRegisters, nodeLastContactMs, now) ? nodeDuePumps(pumps, NUM_PUMPS, now) : 0;
+    nodeRegisters.sensorData = sensorData;
+    if (!nodeConfigStaged)
+    {
+      nodeRegisters.config = currentConfig(pumps, NUM_PUMPS, sensorConfig);
+    }
+    command = nodeRegisters.command;
+  }
+  if (command == NODE_COMMAND_NONE)
+  {
+    return;
+  }
+
+  uint8_t status = NODE_STATUS_OK;
+  uint8_t arg = nodeRegisters.commandArg;
+  switch (command)
+  {
+  case NODE_COMMAND_START_PUMP:
+  case NODE_COMMAND_STOP_PUMP:
+    if (arg >= NUM_PUMPS)
+    {
+      status = NODE_STATUS_BAD_COMMAND;
+    }
+    else if (command == NODE_COMMAND_START_PUMP)
     {
-      analogWrite(pump->getPin(), (255 * pump->getConfig().power) / 100);
+      requestPump(arg);
     }
     else
     {
-      analogWrite(pump->getPin(), 0);
+      stopPump(arg);
     }
+    break;
+  case NODE_COMMAND_COMMIT_CONFIG:
+  {
+    EEPROM_MEM mem;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      mem = nodeRegisters.config;
+    }
+    if (!validateConfig(mem, NUM_PUMPS))
+    {
+      status = NODE_STATUS_INVALID_CONFIG;
+      break;
+    }
+    for (uint8_t i = 0; i < NUM_PUMPS; i++)
+    {
+      pumps[i].setConfig(mem.pumpConfigs[i]);
+    }
+    setSensorConfig(mem.sensorConfig);
+    saveConfig();
+    nodeConfigStaged = false;
+    break;
   }
+  case NODE_COMMAND_RELOAD_CONFIG:
+    nodeConfigStaged = false;
+    break;
+  default:
+    status = NODE_STATUS_BAD_COMMAND;
+    break;
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    nodeRegisters.commandStatus = status;
+    nodeRegisters.command = NODE_COMMAND_NONE;
+  }
+}
+#endif
+
+#ifdef COORDINATOR
+bool wireRead(uint8_t address, uint8_t reg, uint8_t *buf, uint8_t len)
+{
+  for (uint8_t offset = 0; offset < len; offset += NODE_I2C_CHUNK)
+  {
+    uint8_t chunk = min(len - offset, NODE_I2C_CHUNK);
+    Wire.beginTransmission(address);
+    Wire.write(reg + offset);
+    if (Wire.endTransmission(false) != 0 || Wire.requestFrom(address, chunk) != chunk)
+    {
+      return false;
+    }
+    for (uint8_t i = 0; i < chunk; i++)
+    {
+      buf[offset + i] = Wire.read();
+    }
+  }
+  return true;
+}
+
+bool wireWrite(uint8_t address, uint8_t reg, const uint8_t *buf, uint8_t len)
+{
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.write(buf, len);
+  return Wire.endTransmission() == 0;
+}
+
+#ifdef TELEMETRY
+void forwardNodeStatus(uint8_t node, const uint8_t *status)
+{
+  uint8_t payload[NODE_STATUS_SIZE + 1];
+  payload[0] = node;
+  memcpy(payload + 1, status, NODE_STATUS_SIZE);
+  telemetrySend(TELEMETRY_NODE_STATUS, payload, sizeof(payload));
+}
+#endif
+#endif
+
+#ifdef WARM_RESTART
+/**
+  Mirror the runtime state, for a warm restart.
+  */
+void saveWarmState()
+{
+  uint32_t now = clockMillis(&clockManager);
+  warmState.version = WARM_STATE_VERSION;
+  if (uint32_t(now - warmRestoredMs) >= WARM_STABLE_MS)
+  {
+    warmState.restarts = 0;
+  }
+  warmState.uptimeMs = now;
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    PumpRuntime runtime = pumps[i].getRuntime();
+    warmPackPump(&warmState.pumps[i], &runtime, now);
+#ifdef FLOW_METERS
+    warmState.flowPulses[i] = flowMetersPulses(&flowMeters, i);
+#endif
+  }
+  warmState.sensorData = sensorData;
+  warmState.arbiter = arbiter;
+  warmState.faultLatched = faultActive();
+  warmStateSeal(&warmState);
+}
+
+/**
+  After a watchdog or brown-out reset, carry on from the saved state.
+  Returns false for a cold boot, which starts from scratch.
+  */
+bool restoreWarmState()
+{
+  if (!warmStateIsValid(&warmState))
+  {
+    warmState.restarts = 0;
+    return false;
+  }
+  clockResume(&clockManager, warmState.uptimeMs);
+  warmRestoredMs = warmState.uptimeMs;
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    PumpRuntime runtime;
+    warmUnpackPump(&runtime, &warmState.pumps[i], warmState.uptimeMs);
+    if (runtime.running)
+    {
+      // The outputs went low with the reset: soft start the rest of the run again, or the
+      // inrush at full duty could brown out the supply once more
+      uint16_t ranSeconds = (warmState.uptimeMs - runtime.startedAtMs) / 1000ul;
+      runtime.runSeconds = runtime.runSeconds > ranSeconds ? runtime.runSeconds - ranSeconds : 0;
+      runtime.startedAtMs = warmState.uptimeMs;
+    }
+    pumps[i].setRuntime(runtime);
+#ifdef FLOW_METERS
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      flowMeters.pulses[i] = warmState.flowPulses[i];
+    }
+#endif
+  }
+  sensorData = warmState.sensorData;
+  arbiter = warmState.arbiter;
+#ifdef LEAK_SENSOR
+  if (warmState.faultLatched)
+  {
+    // Already logged, still waiting for the acknowledge
+    leakGuard.tripped = true;
+    leakHandled = true;
+  }
+#endif
+  warmState.restarts++;
+  warmStateSeal(&warmState);
+  warmBooted = true;
+  return true;
+}
+#endif
+
+/**
+  The end of GET_STATE, for checking the warm restarts on a board.
+  */
+uint8_t bootState(uint8_t *state)
+{
+#ifdef WARM_RESTART
+  state[0] = warmResetFlags();
+  state[1] = warmBooted;
+  return 2;
+#else
+  return 0;
+#endif
 }
 
 void setup()
 {
+  clockBegin(&clockManager, clockTimings);
 
+#ifdef SCREEN
   // Init the display
   if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C))
   {
@@ -629,6 +1511,18 @@ void setup()
   }
   display.setTextColor(WHITE);
   display.clearDisplay();
+#endif
+  displayPowerBegin(&displayPower, &display);
+
+#ifdef NODE
+  nodeBegin(&nodeRegisters);
+  Wire.begin(NODE_I2C_BASE_ADDRESS + NODE);
+  Wire.onReceive(nodeReceive);
+  Wire.onRequest(nodeRequest);
+#endif
+#ifdef COORDINATOR
+  coordinatorBegin(&coordinator, COORDINATOR);
+#endif
 
   // Init temperature and humidity sensor
   dht.begin();
@@ -643,74 +1537,252 @@ void setup()
   for (uint8_t idx = 0; idx < NUM_PUMPS; idx++)
   {
     pinMode(pumps[idx].getPin(), OUTPUT);
-    pinMode(soilSensorsPins[idx], INPUT);
+    pinMode(sensorsPins[idx], INPUT);
+  }
+  samplerBegin(&sampler, SENSOR_POWER_PIN, sensorsPins, NUM_PUMPS + 1);
+
+#ifdef LEAK_SENSOR
+  pinMode(LEAK_SENSOR_PIN, INPUT_PULLUP);
+  leakGuardBegin(&leakGuard, portInputRegister(digitalPinToPort(LEAK_SENSOR_PIN)), digitalPinToBitMask(LEAK_SENSOR_PIN));
+  for (uint8_t idx = 0; idx < NUM_PUMPS; idx++)
+  {
+    addLeakOutput(pumps[idx].getPin());
   }
+#endif
+#ifdef FLOW_METERS
+  // All on port B, see the PCMSK0 bits below
+  flowMetersBegin(&flowMeters, portInputRegister(digitalPinToPort(FLOW_METER_01)));
+  for (uint8_t idx = 0; idx < NUM_PUMPS; idx++)
+  {
+    pinMode(flowMetersPins[idx], INPUT_PULLUP);
+    flowMetersAdd(&flowMeters, digitalPinToBitMask(flowMetersPins[idx]));
+  }
+#endif
 
   cli();
   // Set PIN On Change Interrupts
   PCICR = 0b00000100;
   PCMSK2 = 0b00111000;
-
-  set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+#ifdef TELEMETRY
+  // Wake up with the serial RX (PD0 PCINT16) too, the host retries the first command
+  PCMSK2 |= 0b00000001;
+#endif
+#ifdef LEAK_SENSOR
+  // Leak probe on PB2 PCINT2
+  PCICR |= 0b00000001;
+  PCMSK0 |= 0b00000100;
+#endif
+#ifdef FLOW_METERS
+  // Flow meters on PB4 PCINT4, PB3 PCINT3 and PB5 PCINT5
+  PCICR |= 0b00000001;
+  PCMSK0 |= 0b00111000;
+#endif
+
+  // Idle keeps timer0 running: the clock and the schedule go on while sleeping
+  set_sleep_mode(SLEEP_MODE_IDLE);
   sei();
 
-  // saveEEPROM();
-  loadEEPROM(pumps, NUM_PUMPS, &sensorConfig);
+  // Even on a warm restart: the EEPROM is the reference for the config, and it only takes a few us
+  loadConfig();
+  arbiterBegin(&arbiter);
+#ifndef HISTORY_EEPROM
+  historyClear(&history);
+#endif
+  bool warm = false;
+#ifdef WARM_RESTART
+  warm = restoreWarmState();
+#endif
+
+#ifdef TELEMETRY
+  telemetryBegin();
+  if (!warm)
+  {
+    // Waits for each frame, not worth delaying the pumps for after a warm restart
+    telemetryConfig(pumps, NUM_PUMPS, sensorConfig);
+  }
+#endif
+
+#ifdef WD
+  // Reset by loop() on every pass, sleeping included: IDLE wakes up on every timer0 tick
+#ifdef WARM_RESTART
+  warmWatchdogEnable();
+#else
+  wdt_enable(WDTO_1S);
+#endif
+#endif
+}
+
+#if defined(LEAK_SENSOR) || defined(FLOW_METERS)
+ISR(PCINT0_vect)
+{
+#ifdef LEAK_SENSOR
+  // First, it's the one in a hurry
+  leakGuardCheck(&leakGuard);
+#endif
+#ifdef FLOW_METERS
+  flowMetersOnPinChange(&flowMeters);
+#endif
 }
+#endif
 
 ISR(PCINT2_vect)
 {
+  // Buttons are active low, ignore the release and the serial RX
+  if ((PIND & 0b00111000) != 0b00111000)
+  {
+    buttonWoke = true;
+  }
 }
 
 void loop()
 {
   static volatile uint8_t isSleeping = 0;
-  uint32_t currentMillis = millis();
+  static uint32_t lastHistoryMs = 0;
+#ifdef WARM_RESTART
+  static uint32_t lastWarmSaveMs = 0;
+#endif
+#ifdef COORDINATOR
+  static uint32_t lastPollMs = 0;
+#endif
+#ifdef TELEMETRY
+  static uint32_t lastTelemetryMs = 0;
+  uint8_t commandType, commandLen;
+  uint8_t commandPayload[TELEMETRY_MAX_PAYLOAD];
+#endif
+  uint32_t currentMillis = clockMillis(&clockManager);
 
   readSensors();
+#ifdef LEAK_SENSOR
+  handleLeak();
+#endif
   checkSchedule();
   runPumps();
+#ifdef WARM_RESTART
+  if (uint32_t(currentMillis - lastWarmSaveMs) >= WARM_SAVE_MS)
+  {
+    lastWarmSaveMs = currentMillis;
+    saveWarmState();
+  }
+#endif
+
+#ifdef NODE
+  updateNode();
+#endif
+#ifdef COORDINATOR
+  if (uint32_t(currentMillis - lastPollMs) >= COORDINATOR_POLL_MS)
+  {
+    lastPollMs = currentMillis;
+#ifdef TELEMETRY
+    coordinatorPoll(&coordinator, wireRead, wireWrite, forwardNodeStatus);
+#else
+    coordinatorPoll(&coordinator, wireRead, wireWrite, NULL);
+#endif
+  }
+#endif
 
+  if (uint32_t(currentMillis - lastHistoryMs) >= HISTORY_INTERVAL_MIN * 60ul * 1000ul)
+  {
+    lastHistoryMs = currentMillis;
+    recordHistory();
+  }
+
+#ifdef TELEMETRY
+  if (telemetryReceive(&commandType, commandPayload, &commandLen))
+  {
+    // Calibrating waits with delay(), and the unit stays awake for the host anyway
+    setClockSlow(false);
+    handleCommand(clockMillis(&clockManager), commandType, commandPayload, commandLen);
+    // Keep the unit awake while the host is talking to it
+    lastDebounceTimeMs = clockMillis(&clockManager);
+  }
+  if (uint32_t(currentMillis - lastTelemetryMs) >= TELEMETRY_INTERVAL_MS)
+  {
+    lastTelemetryMs = currentMillis;
+    telemetrySensorData(currentMillis, sensorData, pumpsRunningMask());
+  }
+#endif
+
+#if defined(WD) && defined(WARM_RESTART)
+  warmWatchdogReset();
+#else
   wdt_reset();
+#endif
+
+  if (buttonWoke)
+  {
+    buttonWoke = false;
+    // The press only wakes the screen up
+    if (displayPower.state == DISPLAY_OFF)
+    {
+      lastDebounceTimeMs = currentMillis;
+    }
+  }
 
-  // Enter sleep mode after SLEEP_TIME and if no pump is active
-  isSleeping = (lastDebounceTimeMs + SLEEP_TIME < currentMillis) && (!anyPumpIsRunning());
+  // Screen off after SLEEP_TIME and if no pump is active
+  uint32_t idleMs = currentMillis - lastDebounceTimeMs;
+  bool screenOff = idleMs >= SLEEP_TIME && !anyPumpIsRunning() && arbiter.queued == 0 && !faultActive();
+  isSleeping = screenOff && !samplerBusy(&sampler);
+#if defined(NODE) || defined(COORDINATOR)
+  // Stay on the bus
+  isSleeping = false;
+#endif
 
-  if (!isSleeping)
+  if (!screenOff)
   {
+    // Full speed for the screen and the buttons
+    setClockSlow(false);
+#ifdef SCREEN
+    displayPowerUpdate(&displayPower, idleMs);
+#endif
+
     int btn1State = digitalRead(BTN_1);
     int btn2State = digitalRead(BTN_2);
     int btn3State = digitalRead(BTN_3);
 
-    if (uint32_t(currentMillis - lastDebounceTimeMs) >= DEBOUNCE_DELAY_MS)
+    if (idleMs >= DEBOUNCE_DELAY_MS)
     {
-      lastDebounceTimeMs = millis();
-      if (!isSleeping)
+      bool pressed = true;
+      if (btn1State == LOW)
+      {
+        btn1Press();
+      }
+      else if (btn2State == LOW)
       {
-        if (btn1State == LOW)
-        {
-          btn1Press();
-        }
-        else if (btn2State == LOW)
-        {
-          btn2Press();
-        }
-        else if (btn3State == LOW)
-        {
-          btn3Press();
-        }
+        btn2Press();
+      }
+      else if (btn3State == LOW)
+      {
+        btn3Press();
+      }
+      else
+      {
+        pressed = false;
+      }
+      if (pressed)
+      {
+        lastDebounceTimeMs = clockMillis(&clockManager);
       }
     }
+#ifdef SCREEN
     render();
+#endif
   }
   else
   {
-    display.clearDisplay();
-    display.display();
-    wdt_disable();
-    sleep_enable();
-    sleep_cpu();
-    sleep_disable();
-    wdt_enable(WDTO_1S);
+#ifdef SCREEN
+    // A few command bytes, the frame stays in the display RAM for the wake up
+    displayPowerOff(&displayPower);
+#endif
+#ifdef CLOCK_SCALING
+    // Only the sensors and the schedule until the next press, on a slower clock
+    setClockSlow(true);
+#endif
+    if (isSleeping)
+    {
+      // Woken up by the next timer0 tick, a button or the serial RX
+      sleep_enable();
+      sleep_cpu();
+      sleep_disable();
+    }
   }
 }
@@ -0,0 +1,118 @@
+#include "node.h"
+
+void nodeBegin(NodeRegisters* regs)
+{
+  memset(regs, 0, sizeof(NodeRegisters));
+  regs->version = NODE_REGISTERS_VERSION;
+}
+
+void nodeRead(const NodeRegisters* regs, uint8_t reg, uint8_t* buf, uint8_t len)
+{
+  for (uint8_t i = 0; i < len; i++)
+  {
+    uint16_t addr = reg + i;
+    buf[i] = addr < sizeof(NodeRegisters) ? ((const uint8_t*)regs)[addr] : 0xFF;
+  }
+}
+
+static bool isWritable(uint16_t addr)
+{
+  return addr == NODE_REG_HOLD ||
+         addr == NODE_REG_COMMAND ||
+         addr == offsetof(NodeRegisters, commandArg) ||
+         (addr >= NODE_REG_CONFIG && addr < sizeof(NodeRegisters));
+}
+
+bool nodeWrite(NodeRegisters* regs, uint8_t reg, const uint8_t* buf, uint8_t len)
+{
+  bool config = false;
+  for (uint8_t i = 0; i < len; i++)
+  {
+    uint16_t addr = reg + i;
+    if (isWritable(addr))
+    {
+      ((uint8_t*)regs)[addr] = buf[i];
+      config |= addr >= NODE_REG_CONFIG;
+    }
+  }
+  return config;
+}
+
+bool nodeIsHeld(const NodeRegisters* regs, uint32_t lastContactMs, uint32_t currentMillis)
+{
+  return regs->hold && (uint32_t)(currentMillis - lastContactMs) < NODE_HOLD_TIMEOUT_MS;
+}
+
+uint8_t nodeDuePumps(Pump* pumps, uint8_t pumpsCount, uint32_t currentMillis)
+{
+  uint8_t due = 0;
+  for (uint8_t i = 0; i < pumpsCount; i++)
+  {
+    if (!pumps[i].isRunning() && pumps[i].isDue(currentMillis))
+    {
+      due |= 1 << i;
+    }
+  }
+  return due;
+}
+
+void coordinatorBegin(Coordinator* coordinator, uint8_t nodesCount)
+{
+  memset(coordinator, 0, sizeof(Coordinator));
+  coordinator->nodesCount = nodesCount < COORDINATOR_MAX_NODES ? nodesCount : COORDINATOR_MAX_NODES;
+}
+
+void coordinatorPoll(Coordinator* coordinator, BusRead busRead, BusWrite busWrite, NodeStatusCallback onStatus)
+{
+  uint8_t status[NODE_STATUS_SIZE];
+  uint8_t active = 0;
+
+  for (uint8_t n = 0; n < coordinator->nodesCount; n++)
+  {
+    NodeStatus* node = &coordinator->nodes[n];
+    node->online = busRead(NODE_I2C_BASE_ADDRESS + n, 0, status, NODE_STATUS_SIZE) &&
+                   status[NODE_REG_VERSION] == NODE_REGISTERS_VERSION;
+    if (!node->online)
+    {
+      continue;
+    }
+    node->hold = status[NODE_REG_HOLD];
+    node->pumpsRunning = status[offsetof(NodeRegisters, pumpsRunning)];
+    node->pumpsDue = status[offsetof(NodeRegisters, pumpsDue)];
+    // A released node with due pumps is about to start them
+    if (node->pumpsRunning || (!node->hold && node->pumpsDue))
+    {
+      active++;
+    }
+    if (onStatus)
+    {
+      onStatus(n, status);
+    }
+  }
+
+  for (uint8_t i = 0; i < coordinator->nodesCount; i++)
+  {
+    uint8_t n = (coordinator->next + i) % coordinator->nodesCount;
+    NodeStatus* node = &coordinator->nodes[n];
+    if (!node->online)
+    {
+      continue;
+    }
+    uint8_t hold = 1;
+    if (!node->hold && node->pumpsDue && !node->pumpsRunning)
+    {
+      // Already released, leave it until its pumps start
+      hold = 0;
+    }
+    else if (node->hold && node->pumpsDue && !node->pumpsRunning && active < COORDINATOR_MAX_ACTIVE)
+    {
+      hold = 0;
+      active++;
+      coordinator->next = (n + 1) % coordinator->nodesCount;
+    }
+    if (hold != node->hold && busWrite(NODE_I2C_BASE_ADDRESS + n, NODE_REG_HOLD, &hold, 1))
+    {
+      node->hold = hold;
+    }
+  }
+}
@@ -1,10 +1,15 @@
 #include "pump.h"
+#include "evapotranspiration.h"
 
-Pump::Pump(uint8_t pin) : pin(pin), lastRunMs(0), startedAtMs(0), running(false), config({DEFAULT_FREQUENCY, DEFAULT_SECONDS_PUMP, DEFAULT_PUMP_POWER, DEFAULT_SOIL_SENSOR, DEFAULT_LIGHT_SENSOR}) {
+Pump::Pump(uint8_t pin) : pin(pin), lastRunMs(0), startedAtMs(0), running(false), config({DEFAULT_FREQUENCY, DEFAULT_SECONDS_PUMP, DEFAULT_PUMP_POWER, DEFAULT_SOIL_SENSOR, DEFAULT_LIGHT_SENSOR, DEFAULT_PUMP_MODE, 0, DEFAULT_DOSE_ML, DEFAULT_FLOW_UL_PER_PULSE}),
+  runSeconds(DEFAULT_SECONDS_PUMP), doseStartMoisture(0), stoppedAtMs(0), settling(false),
+  etElapsedMs(0), etUpdatedMs(0), etFactor(ET_FACTOR_ONE), targetPulses(0) {
 }
 
 void Pump::setLastRunMs(uint32_t lastRunMs) {
   this->lastRunMs = lastRunMs;
+  this->etElapsedMs = 0;
+  this->etUpdatedMs = lastRunMs;
 }
 
 uint32_t Pump::getLastRunMs() {
@@ -39,18 +44,128 @@ void Pump::setStartedAtMs(uint32_t startedAtMs) {
   this->startedAtMs = startedAtMs;
 }
 
-uint16_t Pump::secondsToNextRun(unsigned long currentMillis) {
+void Pump::start(uint32_t currentMillis, uint8_t soilMoisture) {
+  startedAtMs = currentMillis;
+  running = true;
+  runSeconds = doseSeconds(soilMoisture);
+  targetPulses = 0;
+  if (isVolumetric()) {
+    uint32_t ul = config.doseMl * 1000ul;
+    if (config.mode & PUMP_MODE_ET) {
+      ul = (ul * etFactor) / ET_FACTOR_ONE;
+    }
+    uint32_t pulses = (ul + config.flowUlPerPulse - 1) / config.flowUlPerPulse;
+    targetPulses = constrain(pulses, 1ul, 0xFFFFul);
+    runSeconds = config.secondsPump;
+  }
+  doseStartMoisture = soilMoisture;
+  settling = false;
+}
+
+void Pump::stop(uint32_t currentMillis) {
+  if (running) {
+    // The pump may have been cancelled, learn from what actually ran
+    runSeconds = (currentMillis - startedAtMs) / 1000ul;
+    stoppedAtMs = currentMillis;
+    settling = runSeconds > 0;
+  }
+  running = false;
+}
+
+uint16_t Pump::getRunSeconds() {
+  return running ? runSeconds : config.secondsPump;
+}
+
+uint16_t Pump::getEtFactor() {
+  return etFactor;
+}
+
+PumpRuntime Pump::getRuntime() {
+  PumpRuntime runtime = {lastRunMs, startedAtMs, running, runSeconds, doseStartMoisture, stoppedAtMs, settling,
+                         etElapsedMs, etUpdatedMs, etFactor, targetPulses};
+  return runtime;
+}
+
+void Pump::setRuntime(PumpRuntime runtime) {
+  lastRunMs = runtime.lastRunMs;
+  startedAtMs = runtime.startedAtMs;
+  running = runtime.running;
+  runSeconds = runtime.runSeconds;
+  doseStartMoisture = runtime.doseStartMoisture;
+  stoppedAtMs = runtime.stoppedAtMs;
+  settling = runtime.settling;
+  etElapsedMs = runtime.etElapsedMs;
+  etUpdatedMs = runtime.etUpdatedMs;
+  etFactor = runtime.etFactor;
+  targetPulses = runtime.targetPulses;
+}
+
+bool Pump::isVolumetric() {
+  return config.doseMl > 0 && config.flowUlPerPulse > 0;
+}
+
+bool Pump::isDoseReached(uint16_t pulses) {
+  return running && targetPulses > 0 && pulses >= targetPulses;
+}
+
+uint16_t Pump::pulsesToMl(uint16_t pulses) {
+  uint32_t ml = ((uint32_t)pulses * config.flowUlPerPulse) / 1000ul;
+  return constrain(ml, 0ul, 0xFFFFul);
+}
+
+uint32_t Pump::intervalMs() {
+  return config.frequency * 60ul * 1000ul;
+}
+
+uint32_t Pump::elapsedMs(uint32_t currentMillis) {
+  // Integrate the time at the current rate, split to not overflow 32 bits.
+  // Always kept up to date so switching to ET mode doesn't jump.
+  uint32_t delta = currentMillis - etUpdatedMs;
+  etUpdatedMs = currentMillis;
+  etElapsedMs += (delta >> 8) * etFactor + (((delta & 0xFF) * etFactor) >> 8);
+  if (!(config.mode & PUMP_MODE_ET)) {
+    return currentMillis - lastRunMs;
+  }
+  return etElapsedMs;
+}
+
+uint16_t Pump::doseSeconds(uint8_t soilMoisture) {
+  if (!(config.mode & PUMP_MODE_ADAPTIVE) || config.doseGain == 0) {
+    if (config.mode & PUMP_MODE_ET) {
+      uint16_t seconds = ((uint32_t)config.secondsPump * etFactor) / ET_FACTOR_ONE;
+      return constrain(seconds, (uint16_t)MIN_SECONDS_PUMP, (uint16_t)MAX_SECONDS_PUMP);
+    }
+    return config.secondsPump;
+  }
+  int16_t deficit = (int16_t)config.soilSensor + DOSE_TARGET_BAND - soilMoisture;
+  uint16_t seconds = deficit > 0 ? ((uint16_t)deficit * 100u) / config.doseGain : 0;
+  return constrain(seconds, (uint16_t)MIN_SECONDS_PUMP, (uint16_t)config.secondsPump);
+}
+
+uint16_t Pump::secondsToNextRun(uint32_t currentMillis) {
   if (currentMillis < lastRunMs) {
     lastRunMs = 0ul;
   }
-  unsigned long nextRunMs = lastRunMs + (config.frequency * 60ul * 1000ul);
+  if (config.mode & PUMP_MODE_ET) {
+    uint32_t elapsed = elapsedMs(currentMillis);
+    uint32_t left = elapsed < intervalMs() ? intervalMs() - elapsed : 0;
+    // At the current rate
+    return uint16_t(((left / 1000ul) * ET_FACTOR_ONE) / etFactor);
+  }
+  uint32_t nextRunMs = lastRunMs + intervalMs();
   return uint16_t((nextRunMs - currentMillis) / 1000ul);
 }
 
-bool Pump::isTimeToRun(unsigned long currentMillis, SensorData sensorData, uint8_t idx) {
-  bool shouldRun = (currentMillis - lastRunMs) >= (config.frequency * 60ul * 1000ul);
+bool Pump::isDue(uint32_t currentMillis) {
+  return elapsedMs(currentMillis) >= intervalMs();
+}
+
+bool Pump::isTimeToRun(uint32_t currentMillis, SensorData sensorData, uint8_t idx) {
+  etFactor = (config.mode & PUMP_MODE_ET) ? evapotranspirationScale(sensorData.temperature, sensorData.humidity, sensorData.light) : ET_FACTOR_ONE;
+  bool shouldRun = elapsedMs(currentMillis) >= intervalMs();
   if (shouldRun) {
     lastRunMs = currentMillis;
+    etElapsedMs = 0;
   }
 
   shouldRun = shouldRun &&
@@ -60,6 +175,29 @@ bool Pump::isTimeToRun(unsigned long currentMillis, SensorData sensorData, uint8
   return shouldRun;
 }
 
+PumpAction Pump::checkSchedule(uint32_t currentMillis, SensorData sensorData, uint8_t idx) {
+  if (settling && (uint32_t)(currentMillis - stoppedAtMs) >= DOSE_SETTLE_MINUTES * 60ul * 1000ul) {
+    settling = false;
+    int16_t rise = (int16_t)sensorData.soilMoisture[idx] - doseStartMoisture;
+    if ((config.mode & PUMP_MODE_ADAPTIVE) && rise > 0) {
+      uint16_t gain = ((uint16_t)rise * 100u) / runSeconds;
+      gain = constrain(gain, 1u, 255u);
+      if (config.doseGain != 0) {
+        gain = (DOSE_GAIN_ALPHA * gain + (100 - DOSE_GAIN_ALPHA) * config.doseGain) / 100;
+      }
+      config.doseGain = gain;
+      return PUMP_GAIN_LEARNED;
+    }
+  }
+  if (!running && !(settling && (config.mode & PUMP_MODE_ADAPTIVE)) && isTimeToRun(currentMillis, sensorData, idx)) {
+    return PUMP_START;
+  }
+  if (running && (uint32_t)(currentMillis - startedAtMs) >= (uint32_t)runSeconds * 1000ul) {
+    return PUMP_STOP;
+  }
+  return PUMP_IDLE;
+}
+
 void Pump::incFrequency(bool up) {
   uint8_t value = config.frequency + (up ? STEPS_FREQUENCY : -STEPS_FREQUENCY);
   config.frequency = constrain(value, MIN_FREQUENCY, MAX_FREQUENCY);
@@ -85,3 +223,12 @@ void Pump::incLightSensor(bool up) {
   config.lightSensor = constrain(value, MIN_LIGHT_SENSOR, MAX_LIGHT_SENSOR);
 }
 
+void Pump::incDoseMl(bool up) {
+  int value = config.doseMl + (up ? STEPS_DOSE_ML : -STEPS_DOSE_ML);
+  config.doseMl = constrain(value, MIN_DOSE_ML, MAX_DOSE_ML);
+}
+
+void Pump::incMode(bool up) {
+  uint8_t value = config.mode + (up ? 1 : MAX_PUMP_MODE);
+  config.mode = value % (MAX_PUMP_MODE + 1);
+}
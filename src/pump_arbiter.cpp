@@ -0,0 +1,114 @@
+#include "pump_arbiter.h"
+
+void arbiterBegin(PumpArbiter* arbiter)
+{
+  arbiter->queued = 0;
+}
+
+bool arbiterIsQueued(const PumpArbiter* arbiter, uint8_t pumpIdx)
+{
+  for (uint8_t i = 0; i < arbiter->queued; i++)
+  {
+    if (arbiter->queue[i] == pumpIdx)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint8_t arbiterQueuedMask(const PumpArbiter* arbiter)
+{
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < arbiter->queued; i++)
+  {
+    mask |= 1 << arbiter->queue[i];
+  }
+  return mask;
+}
+
+bool arbiterRequest(PumpArbiter* arbiter, uint8_t pumpIdx)
+{
+  if (arbiter->queued == ARBITER_QUEUE_SIZE || arbiterIsQueued(arbiter, pumpIdx))
+  {
+    return false;
+  }
+  arbiter->queue[arbiter->queued++] = pumpIdx;
+  return true;
+}
+
+static void removeAt(PumpArbiter* arbiter, uint8_t pos)
+{
+  arbiter->queued--;
+  for (uint8_t i = pos; i < arbiter->queued; i++)
+  {
+    arbiter->queue[i] = arbiter->queue[i + 1];
+  }
+}
+
+void arbiterCancel(PumpArbiter* arbiter, uint8_t pumpIdx)
+{
+  for (uint8_t i = 0; i < arbiter->queued; i++)
+  {
+    if (arbiter->queue[i] == pumpIdx)
+    {
+      removeAt(arbiter, i);
+      return;
+    }
+  }
+}
+
+uint8_t arbiterNext(PumpArbiter* arbiter, Pump* pumps, uint8_t pumpsCount, uint32_t currentMillis)
+{
+  if (arbiter->queued == 0)
+  {
+    return ARBITER_NONE;
+  }
+
+  uint8_t running = 0;
+  int power = 0;
+  for (uint8_t i = 0; i < pumpsCount; i++)
+  {
+    if (!pumps[i].isRunning())
+    {
+      continue;
+    }
+    // Let the inrush of the last one settle before adding another
+    if ((uint32_t)(currentMillis - pumps[i].getStartedAtMs()) < ARBITER_SOFT_START_MS)
+    {
+      return ARBITER_NONE;
+    }
+    running++;
+    power += pumps[i].getConfig().power;
+  }
+
+  uint8_t pumpIdx = arbiter->queue[0];
+  if (pumpIdx >= pumpsCount || pumps[pumpIdx].isRunning())
+  {
+    // Started some other way meanwhile
+    removeAt(arbiter, 0);
+    return ARBITER_NONE;
+  }
+  if (running >= ARBITER_MAX_PUMPS ||
+      (running > 0 && power + pumps[pumpIdx].getConfig().power > ARBITER_MAX_POWER))
+  {
+    return ARBITER_NONE;
+  }
+  removeAt(arbiter, 0);
+  return pumpIdx;
+}
+
+uint8_t arbiterDuty(Pump* pump, uint32_t currentMillis)
+{
+  if (!pump->isRunning())
+  {
+    return 0;
+  }
+  uint32_t duty = (255ul * pump->getConfig().power) / 100;
+  uint32_t elapsedMs = currentMillis - pump->getStartedAtMs();
+  if (elapsedMs < ARBITER_SOFT_START_MS)
+  {
+    duty = (duty * elapsedMs) / ARBITER_SOFT_START_MS;
+  }
+  return duty;
+}
@@ -0,0 +1,84 @@
+#include "sensor_sampler.h"
+
+void samplerBegin(SensorSampler* sampler, uint8_t powerPin, const uint8_t* channels, uint8_t channelsCount)
+{
+  sampler->powerPin = powerPin;
+  sampler->channels = channels;
+  sampler->channelsCount = channelsCount < SAMPLER_MAX_CHANNELS ? channelsCount : SAMPLER_MAX_CHANNELS;
+  sampler->state = SAMPLER_OFF;
+  sampler->poweredAtMs = 0;
+  sampler->sampledAtMs = 0;
+  sampler->sampled = false;
+  for (uint8_t i = 0; i < SAMPLER_MAX_CHANNELS; i++)
+  {
+    sampler->raw[i] = 0;
+  }
+  pinMode(powerPin, OUTPUT);
+  digitalWrite(powerPin, LOW);
+}
+
+static uint16_t readChannel(uint8_t pin)
+{
+  analogRead(pin);
+  uint16_t sum = 0;
+  for (uint8_t i = 0; i < SAMPLER_BURST; i++)
+  {
+    sum += analogRead(pin);
+  }
+  return (sum + SAMPLER_BURST / 2) / SAMPLER_BURST;
+}
+
+static void readAll(SensorSampler* sampler, uint32_t currentMillis)
+{
+  for (uint8_t i = 0; i < sampler->channelsCount; i++)
+  {
+    sampler->raw[i] = readChannel(sampler->channels[i]);
+  }
+  digitalWrite(sampler->powerPin, LOW);
+  sampler->state = SAMPLER_OFF;
+  sampler->sampledAtMs = currentMillis;
+  sampler->sampled = true;
+}
+
+bool samplerUpdate(SensorSampler* sampler, uint32_t currentMillis, uint32_t intervalMs)
+{
+  switch (sampler->state)
+  {
+  case SAMPLER_OFF:
+    if (!sampler->sampled || (uint32_t)(currentMillis - sampler->sampledAtMs) >= intervalMs)
+    {
+      digitalWrite(sampler->powerPin, HIGH);
+      sampler->poweredAtMs = currentMillis;
+      sampler->state = SAMPLER_SETTLING;
+    }
+    return false;
+  case SAMPLER_SETTLING:
+    if ((uint32_t)(currentMillis - sampler->poweredAtMs) < SAMPLER_SETTLE_MS)
+    {
+      return false;
+    }
+    readAll(sampler, currentMillis);
+    return true;
+  }
+  return false;
+}
+
+void samplerSampleNow(SensorSampler* sampler, uint32_t currentMillis)
+{
+  if (sampler->state == SAMPLER_OFF)
+  {
+    digitalWrite(sampler->powerPin, HIGH);
+    sampler->poweredAtMs = currentMillis;
+  }
+  uint32_t poweredMs = currentMillis - sampler->poweredAtMs;
+  if (poweredMs < SAMPLER_SETTLE_MS)
+  {
+    delay(SAMPLER_SETTLE_MS - poweredMs);
+  }
+  readAll(sampler, currentMillis);
+}
+
+bool samplerBusy(const SensorSampler* sampler)
+{
+  return sampler->state != SAMPLER_OFF;
+}
@@ -0,0 +1,48 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+/**
+ * Minimal stand-in for the Arduino core, so the modules without hardware build on the host
+ * (simulator and tests). Only what they use is here, everything else stays on the board.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Single threaded on the host, the "interrupts" are called from the simulation loop
+#define noInterrupts()
+#define interrupts()
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+/**
+ * Serial port on a file descriptor, e.g. the master side of a pty for the
+ * telemetry tests. Nothing goes out until attach() is called.
+ */
+class HostSerial
+{
+  private:
+    int fd = -1;
+  public:
+    void attach(int fd);
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    // Same room as an empty HardwareSerial TX buffer
+    int availableForWrite();
+    size_t write(uint8_t byte);
+    size_t write(const uint8_t *buffer, size_t size);
+    void flush();
+};
+
+extern HostSerial Serial;
+
+#endif /* SIM_ARDUINO_H */
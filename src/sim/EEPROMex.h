@@ -0,0 +1,62 @@
+#ifndef SIM_EEPROMEX_H
+#define SIM_EEPROMEX_H
+
+/**
+ * Stand-in for EEPROMex on the host: the 1 KB EEPROM of the ATmega328P in RAM,
+ * erased (0xFF) at start like a new chip.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#define EEPROM_SIZE 1024
+
+class EEPROMClassEx
+{
+  public:
+    uint8_t bytes[EEPROM_SIZE];
+
+    EEPROMClassEx()
+    {
+      memset(bytes, 0xFF, EEPROM_SIZE);
+    }
+
+    uint8_t readByte(int address)
+    {
+      return bytes[address];
+    }
+
+    bool updateByte(int address, uint8_t value)
+    {
+      bytes[address] = value;
+      return true;
+    }
+
+    template <class T> int readBlock(int address, T &value)
+    {
+      memcpy(&value, bytes + address, sizeof(T));
+      return sizeof(T);
+    }
+
+    template <class T> int readBlock(int address, T value[], int items)
+    {
+      memcpy(value, bytes + address, sizeof(T) * items);
+      return sizeof(T) * items;
+    }
+
+    template <class T> int updateBlock(int address, const T &value)
+    {
+      memcpy(bytes + address, &value, sizeof(T));
+      return sizeof(T);
+    }
+
+    template <class T> int updateBlock(int address, const T value[], int items)
+    {
+      memcpy(bytes + address, value, sizeof(T) * items);
+      return sizeof(T) * items;
+    }
+};
+
+extern EEPROMClassEx EEPROM;
+
+#endif /* SIM_EEPROMEX_H */
@@ -0,0 +1,314 @@
+/**
+ * Host side simulator of a multi-board setup.
+ *
+ * Runs the real coordinator (node.cpp) against virtual nodes, each with 3 Pump objects,
+ * their arbiter (pump_arbiter.cpp), its register map and a simple soil model, over a simulated I2C bus that counts the
+ * bytes moved. Reports the bus utilisation, the pumps running at the same time and how
+ * long pumps wait for their turn.
+ *
+ *   .pio/build/sim/program bus --nodes 16 --days 7
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "node.h"
+#include "pump_arbiter.h"
+
+#define BUS_SIM_STEP_MS 1000ul
+#define BUS_SIM_PUMPS 3
+// Moisture % gained per second of pumping at 100% power
+#define BUS_SIM_WET_PER_SEC 1.0
+// Start, stop and ack bits around the bytes of a transaction
+#define BUS_TRANSACTION_OVERHEAD_BITS 3
+
+struct VirtualNode
+{
+  std::vector<Pump> pumps;
+  PumpArbiter arbiter;
+  NodeRegisters registers;
+  double moisture[BUS_SIM_PUMPS];
+  double dryPerHour[BUS_SIM_PUMPS];
+  uint32_t dueSinceMs[BUS_SIM_PUMPS];
+  bool due[BUS_SIM_PUMPS];
+  bool wasRunning[BUS_SIM_PUMPS];
+  uint8_t reg; // Register address of the last write
+  uint32_t lastContactMs; // Last transaction from the coordinator
+};
+
+struct BusStats
+{
+  uint64_t bits = 0;
+  uint64_t transactions = 0;
+  uint32_t failed = 0;
+};
+
+static std::vector<VirtualNode> nodes;
+static BusStats bus;
+static uint32_t busNow;
+
+static VirtualNode *nodeAt(uint8_t address)
+{
+  uint8_t n = address - NODE_I2C_BASE_ADDRESS;
+  return n < nodes.size() ? &nodes[n] : NULL;
+}
+
+static void countTransaction(uint16_t bytes)
+{
+  bus.transactions++;
+  // 8 data bits + ack per byte
+  bus.bits += 9ul * bytes + BUS_TRANSACTION_OVERHEAD_BITS;
+}
+
+/**
+ * Same transactions as wireRead in main.cpp: write the register address, then a repeated start
+ * and read in chunks.
+ */
+static bool simBusRead(uint8_t address, uint8_t reg, uint8_t *buf, uint8_t len)
+{
+  VirtualNode *node = nodeAt(address);
+  for (uint8_t offset = 0; offset < len; offset += NODE_I2C_CHUNK)
+  {
+    uint8_t chunk = len - offset < NODE_I2C_CHUNK ? len - offset : NODE_I2C_CHUNK;
+    // Address + register, then address + data
+    countTransaction(2);
+    if (!node)
+    {
+      bus.failed++;
+      return false;
+    }
+    countTransaction(1 + chunk);
+    node->lastContactMs = busNow;
+    node->reg = reg + offset;
+    nodeRead(&node->registers, node->reg, buf + offset, chunk);
+  }
+  return true;
+}
+
+static bool simBusWrite(uint8_t address, uint8_t reg, const uint8_t *buf, uint8_t len)
+{
+  VirtualNode *node = nodeAt(address);
+  countTransaction(2 + len);
+  if (!node)
+  {
+    bus.failed++;
+    return false;
+  }
+  node->lastContactMs = busNow;
+  node->reg = reg;
+  nodeWrite(&node->registers, reg, buf, len);
+  return true;
+}
+
+/**
+ * What loop() does on a node: run the schedule unless held, admit the queued pumps,
+ * then publish the registers.
+ */
+static void stepNode(VirtualNode *node, uint32_t now)
+{
+  NodeRegisters *regs = &node->registers;
+  for (uint8_t i = 0; i < BUS_SIM_PUMPS; i++)
+  {
+    regs->sensorData.soilMoisture[i] = (uint8_t)lround(node->moisture[i]);
+  }
+
+  for (uint8_t i = 0; i < BUS_SIM_PUMPS; i++)
+  {
+    Pump &pump = node->pumps[i];
+    if (nodeIsHeld(regs, node->lastContactMs, now) && !pump.isRunning())
+    {
+      continue;
+    }
+    switch (pump.checkSchedule(now, regs->sensorData, i))
+    {
+    case PUMP_START:
+      arbiterRequest(&node->arbiter, i);
+      break;
+    case PUMP_STOP:
+      pump.stop(now);
+      break;
+    default:
+      break;
+    }
+  }
+
+  uint8_t pumpIdx;
+  while ((pumpIdx = arbiterNext(&node->arbiter, node->pumps.data(), BUS_SIM_PUMPS, now)) != ARBITER_NONE)
+  {
+    node->pumps[pumpIdx].start(now, regs->sensorData.soilMoisture[pumpIdx]);
+  }
+
+  uint8_t running = arbiterQueuedMask(&node->arbiter);
+  for (uint8_t i = 0; i < BUS_SIM_PUMPS; i++)
+  {
+    if (node->pumps[i].isRunning())
+    {
+      running |= 1 << i;
+    }
+  }
+  regs->pumpsRunning = running;
+  regs->pumpsDue = nodeIsHeld(regs, node->lastContactMs, now) ? nodeDuePumps(node->pumps.data(), BUS_SIM_PUMPS, now) : 0;
+}
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: program bus [options]\n"
+          "  --nodes N      nodes on the bus (8)\n"
+          "  --days N       simulated days (7)\n"
+          "  --frequency MIN  --seconds S  --soil X   pump config of every pump\n"
+          "  --missing N    nodes polled but not answering (0)\n"
+          "  --coordinator-dies H   the coordinator stops polling after H hours, the nodes go on alone\n");
+}
+
+int busSimMain(int argc, char **argv)
+{
+  uint32_t nodesCount = 8;
+  uint32_t missing = 0;
+  uint32_t days = 7;
+  double coordinatorDiesHours = -1;
+  PumpConfig config = {DEFAULT_FREQUENCY, DEFAULT_SECONDS_PUMP, DEFAULT_PUMP_POWER, DEFAULT_SOIL_SENSOR, 0, DEFAULT_PUMP_MODE, 0, DEFAULT_DOSE_ML, DEFAULT_FLOW_UL_PER_PULSE};
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+    {
+      usage();
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--nodes")
+      nodesCount = atoi(value);
+    else if (arg == "--days")
+      days = atoi(value);
+    else if (arg == "--frequency")
+      config.frequency = atoi(value);
+    else if (arg == "--seconds")
+      config.secondsPump = atoi(value);
+    else if (arg == "--soil")
+      config.soilSensor = atoi(value);
+    else if (arg == "--missing")
+      missing = atoi(value);
+    else if (arg == "--coordinator-dies")
+      coordinatorDiesHours = atof(value);
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+  if (nodesCount + missing > COORDINATOR_MAX_NODES)
+  {
+    fprintf(stderr, "at most %d nodes\n", COORDINATOR_MAX_NODES);
+    return 1;
+  }
+
+  srand(1);
+  nodes.resize(nodesCount);
+  for (uint32_t n = 0; n < nodesCount; n++)
+  {
+    VirtualNode &node = nodes[n];
+    nodeBegin(&node.registers);
+    arbiterBegin(&node.arbiter);
+    node.registers.hold = 1;
+    node.reg = 0;
+    node.lastContactMs = 0;
+    for (uint8_t i = 0; i < BUS_SIM_PUMPS; i++)
+    {
+      node.pumps.push_back(Pump(i));
+      node.pumps[i].setConfig(config);
+      // Boards powered up within the same minute, so their schedules line up
+      node.pumps[i].setLastRunMs(-(int32_t)(rand() % 60) * 1000);
+      node.moisture[i] = 50 + rand() % 30;
+      node.dryPerHour[i] = 0.5 + (rand() % 100) / 100.0;
+      node.due[i] = false;
+      node.wasRunning[i] = false;
+      node.dueSinceMs[i] = 0;
+    }
+  }
+
+  Coordinator coordinator;
+  coordinatorBegin(&coordinator, nodesCount + missing);
+
+  uint32_t maxRunning = 0;
+  uint32_t maxActiveNodes = 0;
+  uint64_t runningSamples = 0;
+  uint32_t starts = 0;
+  uint32_t waits = 0;
+  uint32_t skips = 0;
+  double waitTotalS = 0;
+  double waitMaxS = 0;
+  uint64_t totalMs = (uint64_t)days * 24ul * 3600ul * 1000ul;
+  uint64_t lastPollMs = 0;
+  uint64_t coordinatorDiesMs = coordinatorDiesHours >= 0 ? (uint64_t)(coordinatorDiesHours * 3600000.0) : UINT64_MAX;
+
+  for (uint64_t ms = 0; ms < totalMs; ms += BUS_SIM_STEP_MS)
+  {
+    uint32_t now = (uint32_t)ms;
+    busNow = now;
+    if (ms - lastPollMs >= COORDINATOR_POLL_MS && ms < coordinatorDiesMs)
+    {
+      lastPollMs = ms;
+      coordinatorPoll(&coordinator, simBusRead, simBusWrite, NULL);
+    }
+
+    uint32_t running = 0;
+    uint32_t activeNodes = 0;
+    for (uint32_t n = 0; n < nodesCount; n++)
+    {
+      VirtualNode &node = nodes[n];
+      stepNode(&node, now);
+      bool active = false;
+      for (uint8_t i = 0; i < BUS_SIM_PUMPS; i++)
+      {
+        Pump &pump = node.pumps[i];
+        if (pump.isRunning())
+        {
+          running++;
+          active = true;
+          starts += !node.wasRunning[i];
+          node.moisture[i] = fmin(100, node.moisture[i] + BUS_SIM_WET_PER_SEC * config.power / 100.0 * BUS_SIM_STEP_MS / 1000.0);
+          if (node.due[i])
+          {
+            double waitS = (now - node.dueSinceMs[i]) / 1000.0;
+            waits++;
+            waitTotalS += waitS;
+            waitMaxS = fmax(waitMaxS, waitS);
+            node.due[i] = false;
+          }
+        }
+        else if (!node.due[i] && pump.isDue(now))
+        {
+          node.due[i] = true;
+          node.dueSinceMs[i] = now;
+        }
+        else if (node.due[i] && !pump.isDue(now) && !arbiterIsQueued(&node.arbiter, i))
+        {
+          // Got its turn, but the soil was wet enough: skipped until the next interval
+          node.due[i] = false;
+          skips++;
+        }
+        node.wasRunning[i] = pump.isRunning();
+        node.moisture[i] = fmax(0, node.moisture[i] - node.dryPerHour[i] * BUS_SIM_STEP_MS / 3600000.0);
+      }
+      activeNodes += active;
+    }
+    maxRunning = running > maxRunning ? running : maxRunning;
+    maxActiveNodes = activeNodes > maxActiveNodes ? activeNodes : maxActiveNodes;
+    runningSamples += running;
+  }
+
+  double seconds = totalMs / 1000.0;
+  double polls = seconds * 1000.0 / COORDINATOR_POLL_MS;
+  printf("nodes,missing,bus_utilisation_pct,bytes_per_poll,failed_per_poll,max_pumps_running,max_nodes_active,mean_pumps_running,pump_starts,skipped,mean_wait_s,max_wait_s\n");
+  printf("%u,%u,%.3f,%.1f,%.2f,%u,%u,%.3f,%u,%u,%.1f,%.1f\n", nodesCount, missing,
+         100.0 * bus.bits / NODE_I2C_CLOCK / seconds, bus.bits / 9.0 / polls, bus.failed / polls,
+         maxRunning, maxActiveNodes, runningSamples / (seconds * 1000.0 / BUS_SIM_STEP_MS), starts, skips,
+         waits ? waitTotalS / waits : 0, waitMaxS);
+  return 0;
+}
@@ -0,0 +1,3 @@
+#include "EEPROMex.h"
+
+EEPROMClassEx EEPROM;
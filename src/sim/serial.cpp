@@ -0,0 +1,68 @@
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+
+#define SERIAL_TX_BUFFER_SIZE 64
+
+HostSerial Serial;
+
+void HostSerial::attach(int fd)
+{
+  this->fd = fd;
+}
+
+void HostSerial::begin(unsigned long baud)
+{
+}
+
+int HostSerial::available()
+{
+  int count = 0;
+  if (fd < 0 || ioctl(fd, FIONREAD, &count) < 0)
+  {
+    return 0;
+  }
+  return count;
+}
+
+int HostSerial::read()
+{
+  uint8_t byte;
+  if (available() == 0 || ::read(fd, &byte, 1) != 1)
+  {
+    return -1;
+  }
+  return byte;
+}
+
+int HostSerial::availableForWrite()
+{
+  return SERIAL_TX_BUFFER_SIZE - 1;
+}
+
+size_t HostSerial::write(uint8_t byte)
+{
+  return write(&byte, 1);
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size)
+{
+  size_t written = 0;
+  while (fd >= 0 && written < size)
+  {
+    ssize_t count = ::write(fd, buffer + written, size - written);
+    if (count < 0 && errno != EINTR)
+    {
+      break;
+    }
+    written += count > 0 ? count : 0;
+  }
+  return written;
+}
+
+void HostSerial::flush()
+{
+  // write() hands everything to the fd already
+}
@@ -0,0 +1,492 @@
+/**
+ * Host side simulator of the watering schedule.
+ *
+ * Runs the real Pump scheduling logic (pump.cpp) against a virtual clock, with the
+ * sensors coming either from a simple soil model or from a recorded trace
+ * (the CSV written by tools/telemetry_decode.py). Months run in seconds, and a whole
+ * grid of configs can be swept on every core to pick defaults for pump_config.h.
+ *
+ *   pio run -e sim
+ *   .pio/build/sim/program --days 90 --frequency 60 --seconds 20 --soil 50
+ *   .pio/build/sim/program --days 90 --sweep > sweep.csv
+ *   .pio/build/sim/program --days 30 --dose 250 --flow-ul-pulse 2200 --meter-ul-pulse 2250
+ *   .pio/build/sim/program bus --nodes 16 --days 7   (multi-board bus, see bus_sim.cpp)
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "flow_meter.h"
+#include "leak_guard.h"
+#include "pump.h"
+
+#define SIM_STEP_MS 1000ul
+#define SIM_PUMP_STEP_MS 1ul // While a pump runs, so the leak reaction and the dose stop are timed to the ms
+
+int busSimMain(int argc, char **argv);
+
+struct SimParams
+{
+  uint32_t days = 30;
+  double flowMlPerSec = 20;  // Pump flow at 100% power
+  double gainPerMl = 0.05;   // Moisture % per ml absorbed by the pot
+  double absorbMinutes = 3;  // Time constant of the water spreading to the sensor
+  double dryPerHourDay = 1.0;  // Moisture % lost per hour at full light and 1 kPa of VPD
+  double dryPerHourNight = 0.2;
+  double startMoisture = 60;
+  int stressBelow = -1; // Count the time below this moisture, -1 to use the pump threshold
+  double leakAtHours = -1; // The tube pops off at this time: the water goes to the saucer, -1 for no leak
+  double saucerMl = 200;   // The leak probe sits in the saucer, wet once it's full
+  bool leakGuard = true;   // Cut the pump from the probe interrupt, or only on the schedule
+  double meterUlPerPulse = 0; // True K factor of the flow meter, 0 for no meter (flowUlPerPulse is the configured one)
+};
+
+struct SimResult
+{
+  double waterMl = 0;
+  double runoffMl = 0; // Water poured into an already saturated pot
+  double hoursBelow = 0;
+  uint32_t starts = 0;
+  double floorMl = 0;     // Leaked water past the full saucer
+  double reactionMs = -1; // From the probe getting wet to the pump output going low
+  double meteredMl = 0;   // What the firmware measured with the flow meter
+};
+
+struct TraceRow
+{
+  uint32_t ms;
+  int8_t temperature;
+  uint8_t humidity;
+  uint8_t light;
+  uint8_t soil[3];
+};
+
+struct Trace
+{
+  std::vector<TraceRow> rows;
+  uint8_t pump = 0;
+  bool modelSoil = false; // Take only light/temperature/humidity from the trace
+};
+
+/**
+ * Read the sensor rows of a telemetry_decode.py CSV.
+ */
+static bool loadTrace(const char *path, Trace *trace)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    return false;
+  }
+  char line[256];
+  uint32_t firstMs = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    unsigned long ms;
+    int temp, humid, light, s1, s2, s3;
+    if (sscanf(line, "sensor,%lu,%d,%d,%d,%d,%d,%d", &ms, &temp, &humid, &light, &s1, &s2, &s3) != 7)
+    {
+      continue;
+    }
+    if (trace->rows.empty())
+    {
+      firstMs = ms;
+    }
+    TraceRow row = {(uint32_t)(ms - firstMs), (int8_t)temp, (uint8_t)humid, (uint8_t)light, {(uint8_t)s1, (uint8_t)s2, (uint8_t)s3}};
+    trace->rows.push_back(row);
+  }
+  fclose(f);
+  return !trace->rows.empty();
+}
+
+/**
+ * Light follows the sun from 6h to 18h, temperature and humidity follow the light.
+ * On top, the weather swings between cool humid and hot dry spells every 2 weeks.
+ */
+static void modelEnvironment(uint64_t ms, SensorData *sensorData)
+{
+  double hour = fmod(ms / 3600000.0, 24.0);
+  double sun = hour > 6 && hour < 18 ? sin(M_PI * (hour - 6) / 12) : 0;
+  double spell = sin(2 * M_PI * ms / (14 * 24 * 3600000.0));
+  sensorData->light = (uint8_t)lround(sun * 100);
+  sensorData->temperature = (int8_t)lround(16 + 10 * sun + 7 * spell);
+  sensorData->humidity = (uint8_t)lround(70 - 25 * sun - 15 * spell);
+}
+
+/**
+ * Vapour pressure deficit in kPa, computed in full precision for the model.
+ */
+static double modelVpd(const SensorData &sensorData)
+{
+  double saturation = 0.61078 * exp(17.27 * sensorData.temperature / (sensorData.temperature + 237.3));
+  return saturation * (100 - sensorData.humidity) / 100;
+}
+
+SimResult simulate(PumpConfig config, const SimParams &params, const Trace *trace)
+{
+  SimResult result;
+  Pump pump(0);
+  pump.setConfig(config);
+
+  SensorData sensorData = {};
+
+  // The leak guard drives fake registers: the probe input, and the pump output bit
+  volatile uint8_t probePin = 1;
+  volatile uint8_t pumpPort = 0;
+  LeakGuard guard;
+  leakGuardBegin(&guard, &probePin, 1);
+  leakGuardAddOutput(&guard, &pumpPort, 1, NULL, 0);
+  double saucerMl = 0;
+  uint64_t wetAtMs = 0;
+  uint64_t leakAtMs = params.leakAtHours >= 0 ? (uint64_t)(params.leakAtHours * 3600000.0) : UINT64_MAX;
+
+  // The meter toggles a fake PINB bit, counted the way the pin change ISR does
+  volatile uint8_t flowPin = 0;
+  FlowMeters meters;
+  flowMetersBegin(&meters, &flowPin);
+  flowMetersAdd(&meters, 1 << 4);
+  double meterUl = 0; // Went through the meter since its last pulse
+
+  double moisture = params.startMoisture;
+  double pendingMl = 0; // Pumped, not reached the sensor yet
+  int stressBelow = params.stressBelow >= 0 ? params.stressBelow : config.soilSensor;
+  size_t traceIdx = 0;
+  uint64_t traceLoopMs = 0;
+  uint64_t totalMs = (uint64_t)params.days * 24ul * 3600ul * 1000ul;
+
+  uint64_t stepMs = SIM_STEP_MS;
+  for (uint64_t ms = 0; ms < totalMs; ms += stepMs)
+  {
+    // millis() on the board is 32 bits, let it wrap the same way
+    uint32_t now = (uint32_t)ms;
+
+    if (trace)
+    {
+      // Replay the trace in a loop, keeping the latest row before now
+      uint64_t traceMs = ms - traceLoopMs;
+      if (traceMs > trace->rows.back().ms)
+      {
+        traceLoopMs = ms;
+        traceIdx = 0;
+        traceMs = 0;
+      }
+      while (traceIdx + 1 < trace->rows.size() && trace->rows[traceIdx + 1].ms <= traceMs)
+      {
+        traceIdx++;
+      }
+      const TraceRow &row = trace->rows[traceIdx];
+      sensorData.light = row.light;
+      sensorData.temperature = row.temperature;
+      sensorData.humidity = row.humidity;
+      if (!trace->modelSoil)
+      {
+        moisture = row.soil[trace->pump];
+      }
+    }
+    else
+    {
+      modelEnvironment(ms, &sensorData);
+    }
+    sensorData.soilMoisture[0] = (uint8_t)lround(moisture);
+
+    switch (guard.tripped ? PUMP_IDLE : pump.checkSchedule(now, sensorData, 0))
+    {
+    case PUMP_START:
+      result.meteredMl += pump.pulsesToMl(flowMetersPulses(&meters, 0));
+      flowMetersReset(&meters, 0);
+      meterUl = 0;
+      pump.start(now, sensorData.soilMoisture[0]);
+      pumpPort |= 1;
+      result.starts++;
+      break;
+    case PUMP_STOP:
+      pump.stop(now);
+      pumpPort &= ~1;
+      break;
+    default:
+      break;
+    }
+
+    stepMs = pump.isRunning() ? SIM_PUMP_STEP_MS : SIM_STEP_MS;
+    double step = stepMs / 1000.0;
+    if (pump.isRunning() && (pumpPort & 1))
+    {
+      double ml = params.flowMlPerSec * config.power / 100.0 * step;
+      if (params.meterUlPerPulse > 0)
+      {
+        meterUl += ml * 1000;
+        while (meterUl >= params.meterUlPerPulse)
+        {
+          meterUl -= params.meterUlPerPulse;
+          flowPin |= 1 << 4;
+          flowMetersOnPinChange(&meters);
+          flowPin &= ~(1 << 4);
+          flowMetersOnPinChange(&meters);
+          if (pump.isDoseReached(flowMetersPulses(&meters, 0)))
+          {
+            // Stopped right at this pulse, the rest of the step isn't pumped
+            ml -= meterUl / 1000;
+            meterUl = 0;
+            pump.stop(now);
+            pumpPort &= ~1;
+            break;
+          }
+        }
+      }
+      result.waterMl += ml;
+      if (ms >= leakAtMs)
+      {
+        saucerMl += ml;
+      }
+      else
+      {
+        pendingMl += ml;
+      }
+    }
+    if (saucerMl > params.saucerMl)
+    {
+      result.floorMl += saucerMl - params.saucerMl;
+      saucerMl = params.saucerMl;
+      if (probePin & 1)
+      {
+        // The probe gets wet, the pin change interrupt fires
+        probePin &= ~1;
+        wetAtMs = ms;
+        if (params.leakGuard)
+        {
+          leakGuardCheck(&guard);
+        }
+      }
+    }
+    if (!(probePin & 1) && result.reactionMs < 0 && !(pumpPort & 1 && pump.isRunning()))
+    {
+      result.reactionMs = ms - wetAtMs;
+    }
+    if (pump.isRunning() && !(pumpPort & 1))
+    {
+      // What handleLeak() does in the next loop
+      pump.stop(now);
+    }
+    double absorbedMl = pendingMl * fmin(1, step / (params.absorbMinutes * 60));
+    pendingMl -= absorbedMl;
+    moisture += absorbedMl * params.gainPerMl;
+    if (moisture > 100)
+    {
+      result.runoffMl += (moisture - 100) / params.gainPerMl;
+      moisture = 100;
+    }
+    double dryPerHour = params.dryPerHourNight + (params.dryPerHourDay - params.dryPerHourNight) * sensorData.light / 100.0 * modelVpd(sensorData);
+    moisture = fmax(0, moisture - dryPerHour * step / 3600.0);
+
+    if (sensorData.soilMoisture[0] < stressBelow)
+    {
+      result.hoursBelow += step / 3600.0;
+    }
+  }
+  result.meteredMl += pump.pulsesToMl(flowMetersPulses(&meters, 0));
+  return result;
+}
+
+static void printHeader()
+{
+  printf("frequency,secondsPump,power,soilSensor,lightSensor,mode,water_ml_per_day,runoff_ml_per_day,hours_below_per_day,starts_per_day,floor_ml,leak_reaction_ms,ml_per_run,metered_ml_per_run\n");
+}
+
+static void printResult(PumpConfig config, const SimParams &params, SimResult result)
+{
+  double runs = result.starts > 0 ? result.starts : 1;
+  printf("%d,%d,%d,%d,%d,%d,%.1f,%.1f,%.2f,%.2f,%.1f,%.0f,%.1f,%.1f\n", config.frequency, config.secondsPump, config.power,
+         config.soilSensor, config.lightSensor, config.mode, result.waterMl / params.days, result.runoffMl / params.days,
+         result.hoursBelow / params.days, (double)result.starts / params.days, result.floorMl, result.reactionMs,
+         result.waterMl / runs, result.meteredMl / runs);
+}
+
+/**
+ * Every combination of the main knobs, in the steps the buttons allow.
+ */
+static std::vector<PumpConfig> sweepConfigs(PumpConfig base)
+{
+  std::vector<PumpConfig> configs;
+  for (int frequency = 15; frequency <= 720; frequency *= 2)
+  {
+    for (int seconds = MIN_SECONDS_PUMP; seconds <= 60; seconds += STEPS_SECONDS_PUMP)
+    {
+      for (int soil = 30; soil <= 80; soil += 10)
+      {
+        PumpConfig config = base;
+        config.frequency = frequency;
+        config.secondsPump = seconds;
+        config.soilSensor = soil;
+        configs.push_back(config);
+      }
+    }
+  }
+  return configs;
+}
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: program [options]\n"
+          "       program bus [options]   multi-board bus simulator\n"
+          "  --days N             simulated days (30)\n"
+          "  --frequency MIN      --seconds S  --power P  --soil X  --light L   pump config\n"
+          "  --adaptive           adaptive dosing (PUMP_MODE_ADAPTIVE)\n"
+          "  --et                 evapotranspiration scheduling (PUMP_MODE_ET)\n"
+          "  --sweep              run a grid of configs, CSV output\n"
+          "  --threads N          threads for --sweep (all cores)\n"
+          "  --trace FILE         replay a telemetry_decode.py CSV instead of the model\n"
+          "  --trace-pump I       soil column of the trace (0)\n"
+          "  --model-soil         only take light/temperature/humidity from the trace\n"
+          "  --leak-at H          the tube pops off after H hours, the water fills the saucer with the leak probe\n"
+          "  --saucer ML          saucer volume (200)\n"
+          "  --no-leak-guard      only stop the pump on its schedule, as without the probe interrupt\n"
+          "  --dose ML            volumetric dose (doseMl), --seconds is then the safety limit\n"
+          "  --flow-ul-pulse UL   configured flow meter calibration (flowUlPerPulse)\n"
+          "  --meter-ul-pulse UL  true ul per pulse of the simulated meter, none if not set\n"
+          "  --flow ML_S --gain PCT_ML --absorb MIN --dry-day PCT_H --dry-night PCT_H --start PCT --stress PCT   soil model\n");
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 && std::string(argv[1]) == "bus")
+  {
+    return busSimMain(argc - 1, argv + 1);
+  }
+
+  SimParams params;
+  PumpConfig config = {DEFAULT_FREQUENCY, DEFAULT_SECONDS_PUMP, DEFAULT_PUMP_POWER, DEFAULT_SOIL_SENSOR, DEFAULT_LIGHT_SENSOR, DEFAULT_PUMP_MODE, 0, DEFAULT_DOSE_ML, DEFAULT_FLOW_UL_PER_PULSE};
+  Trace trace;
+  bool useTrace = false;
+  bool sweep = false;
+  unsigned threads = std::thread::hardware_concurrency();
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    const char *value = hasValue ? argv[i + 1] : "";
+    if (arg == "--sweep")
+    {
+      sweep = true;
+      continue;
+    }
+    if (arg == "--model-soil")
+    {
+      trace.modelSoil = true;
+      continue;
+    }
+    if (arg == "--adaptive")
+    {
+      config.mode |= PUMP_MODE_ADAPTIVE;
+      continue;
+    }
+    if (arg == "--et")
+    {
+      config.mode |= PUMP_MODE_ET;
+      continue;
+    }
+    if (arg == "--no-leak-guard")
+    {
+      params.leakGuard = false;
+      continue;
+    }
+    if (!hasValue)
+    {
+      usage();
+      return 1;
+    }
+    i++;
+    if (arg == "--days")
+      params.days = atoi(value);
+    else if (arg == "--frequency")
+      config.frequency = atoi(value);
+    else if (arg == "--seconds")
+      config.secondsPump = atoi(value);
+    else if (arg == "--power")
+      config.power = atoi(value);
+    else if (arg == "--soil")
+      config.soilSensor = atoi(value);
+    else if (arg == "--light")
+      config.lightSensor = atoi(value);
+    else if (arg == "--threads")
+      threads = atoi(value);
+    else if (arg == "--trace")
+    {
+      if (!loadTrace(value, &trace))
+      {
+        fprintf(stderr, "can't read a trace from %s\n", value);
+        return 1;
+      }
+      useTrace = true;
+    }
+    else if (arg == "--trace-pump")
+      trace.pump = atoi(value) % 3;
+    else if (arg == "--flow")
+      params.flowMlPerSec = atof(value);
+    else if (arg == "--gain")
+      params.gainPerMl = atof(value);
+    else if (arg == "--absorb")
+      params.absorbMinutes = atof(value);
+    else if (arg == "--dry-day")
+      params.dryPerHourDay = atof(value);
+    else if (arg == "--dry-night")
+      params.dryPerHourNight = atof(value);
+    else if (arg == "--start")
+      params.startMoisture = atof(value);
+    else if (arg == "--stress")
+      params.stressBelow = atoi(value);
+    else if (arg == "--leak-at")
+      params.leakAtHours = atof(value);
+    else if (arg == "--saucer")
+      params.saucerMl = atof(value);
+    else if (arg == "--dose")
+      config.doseMl = atoi(value);
+    else if (arg == "--flow-ul-pulse")
+      config.flowUlPerPulse = atoi(value);
+    else if (arg == "--meter-ul-pulse")
+      params.meterUlPerPulse = atof(value);
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  const Trace *tracePtr = useTrace ? &trace : NULL;
+  printHeader();
+  if (!sweep)
+  {
+    printResult(config, params, simulate(config, params, tracePtr));
+    return 0;
+  }
+
+  std::vector<PumpConfig> configs = sweepConfigs(config);
+  std::vector<SimResult> results(configs.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < (threads > 0 ? threads : 1); t++)
+  {
+    workers.push_back(std::thread([&]() {
+      for (size_t i = next++; i < configs.size(); i = next++)
+      {
+        results[i] = simulate(configs[i], params, tracePtr);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++)
+  {
+    workers[t].join();
+  }
+  for (size_t i = 0; i < configs.size(); i++)
+  {
+    printResult(configs[i], params, results[i]);
+  }
+  return 0;
+}
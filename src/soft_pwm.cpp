@@ -0,0 +1,137 @@
+#include "soft_pwm.h"
+
+#include <avr/interrupt.h>
+
+struct SoftPwmChannel
+{
+  uint8_t pin;
+  volatile uint8_t *port;
+  uint8_t mask;
+  uint8_t duty;
+};
+
+// pin 0xFF: free
+static SoftPwmChannel channels[SOFT_PWM_CHANNELS] = {{0xFF, NULL, 0, 0}, {0xFF, NULL, 0, 0}};
+// Channels set by the overflow: a duty between 0 and 255
+static volatile uint8_t activeMask = 0;
+
+static void timerBegin()
+{
+  // Fast PWM, TOP 0xFF, clk/64, no output on OC2A/OC2B
+  TCCR2A = _BV(WGM21) | _BV(WGM20);
+  TCCR2B = _BV(CS22);
+}
+
+// Compare interrupt of a channel: OCR2A for the first, OCR2B for the second
+static void setCompare(uint8_t channel, uint8_t duty)
+{
+  if (channel == 0)
+  {
+    OCR2A = duty;
+  }
+  else
+  {
+    OCR2B = duty;
+  }
+}
+
+static uint8_t compareInterrupt(uint8_t channel)
+{
+  return channel == 0 ? _BV(OCIE2A) : _BV(OCIE2B);
+}
+
+bool softPwmWrite(uint8_t pin, uint8_t duty)
+{
+  uint8_t channel = SOFT_PWM_CHANNELS;
+  for (uint8_t i = 0; i < SOFT_PWM_CHANNELS; i++)
+  {
+    if (channels[i].pin == pin)
+    {
+      channel = i;
+      break;
+    }
+    if (channels[i].pin == 0xFF && channel == SOFT_PWM_CHANNELS)
+    {
+      channel = i;
+    }
+  }
+  if (channel == SOFT_PWM_CHANNELS)
+  {
+    return false;
+  }
+
+  SoftPwmChannel *c = &channels[channel];
+  if (c->pin != pin)
+  {
+    if (channels[1 - channel].pin == 0xFF)
+    {
+      timerBegin();
+    }
+    c->pin = pin;
+    c->port = portOutputRegister(digitalPinToPort(pin));
+    c->mask = digitalPinToBitMask(pin);
+    c->duty = 0;
+    pinMode(pin, OUTPUT);
+  }
+  if (c->duty == duty)
+  {
+    return true;
+  }
+  c->duty = duty;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  setCompare(channel, duty);
+  if (duty == 0 || duty == 255)
+  {
+    // No edge to make: the pin just stays where it is
+    TIMSK2 &= ~compareInterrupt(channel);
+    activeMask &= ~_BV(channel);
+    if (duty == 0)
+    {
+      *c->port &= ~c->mask;
+    }
+    else
+    {
+      *c->port |= c->mask;
+    }
+  }
+  else
+  {
+    TIFR2 = compareInterrupt(channel);
+    TIMSK2 |= compareInterrupt(channel);
+    activeMask |= _BV(channel);
+  }
+  if (activeMask)
+  {
+    TIMSK2 |= _BV(TOIE2);
+  }
+  else
+  {
+    TIMSK2 &= ~_BV(TOIE2);
+  }
+  SREG = oldSREG;
+  return true;
+}
+
+ISR(TIMER2_OVF_vect)
+{
+  if (activeMask & _BV(0))
+  {
+    *channels[0].port |= channels[0].mask;
+  }
+  if (activeMask & _BV(1))
+  {
+    *channels[1].port |= channels[1].mask;
+  }
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+  *channels[0].port &= ~channels[0].mask;
+}
+
+ISR(TIMER2_COMPB_vect)
+{
+  *channels[1].port &= ~channels[1].mask;
+}
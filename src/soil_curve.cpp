@@ -0,0 +1,47 @@
+#include "soil_curve.h"
+
+uint8_t soilCurveSegment(uint16_t raw)
+{
+  return (raw > 1023 ? 1023 : raw) >> SOIL_CURVE_SHIFT;
+}
+
+uint8_t soilCurveInterpolate(uint8_t low, uint8_t high, uint16_t raw)
+{
+  uint8_t fraction = (raw > 1023 ? 1023 : raw) & ((1 << SOIL_CURVE_SHIFT) - 1);
+  int16_t delta = high - low;
+  // Rounded to the nearest %
+  return low + ((delta * fraction + (1 << (SOIL_CURVE_SHIFT - 1))) >> SOIL_CURVE_SHIFT);
+}
+
+bool soilCurveIsValid(const uint8_t* knots)
+{
+  bool rising = false;
+  bool falling = false;
+  for (uint8_t i = 0; i < SOIL_CURVE_KNOTS; i++)
+  {
+    if (knots[i] > 100)
+    {
+      return false;
+    }
+    if (i > 0)
+    {
+      rising |= knots[i] > knots[i - 1];
+      falling |= knots[i] < knots[i - 1];
+    }
+  }
+  return !(rising && falling);
+}
+
+void soilCurveLinear(uint8_t* knots, int dryValue, int wetValue)
+{
+  for (uint8_t i = 0; i < SOIL_CURVE_KNOTS; i++)
+  {
+    long raw = (long)i << SOIL_CURVE_SHIFT;
+    long value = 0;
+    if (wetValue != dryValue)
+    {
+      value = (raw - dryValue) * 100 / (wetValue - dryValue);
+    }
+    knots[i] = value < 0 ? 0 : (value > 100 ? 100 : value);
+  }
+}
@@ -0,0 +1,170 @@
+#include "telemetry.h"
+
+static uint8_t telemetrySeq = 0;
+
+static uint8_t rxBuffer[TELEMETRY_MAX_ENCODED];
+static uint8_t rxLen = 0;
+static bool rxOverflow = false;
+
+static uint8_t put32(uint8_t* buf, uint32_t value)
+{
+  buf[0] = value;
+  buf[1] = value >> 8;
+  buf[2] = value >> 16;
+  buf[3] = value >> 24;
+  return 4;
+}
+
+static uint8_t put16(uint8_t* buf, uint16_t value)
+{
+  buf[0] = value;
+  buf[1] = value >> 8;
+  return 2;
+}
+
+void telemetryBegin()
+{
+  Serial.begin(TELEMETRY_BAUD);
+}
+
+bool telemetrySend(uint8_t type, const uint8_t* payload, uint8_t len)
+{
+  uint8_t frame[TELEMETRY_MAX_FRAME];
+  uint8_t encoded[TELEMETRY_MAX_ENCODED];
+
+  if (len > TELEMETRY_MAX_PAYLOAD)
+  {
+    return false;
+  }
+
+  frame[0] = type;
+  frame[1] = telemetrySeq++;
+  memcpy(frame + 2, payload, len);
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < len + 2; i++)
+  {
+    crc = crc16Update(crc, frame[i]);
+  }
+  len += 2;
+  len += put16(frame + len, crc);
+
+  uint8_t encodedLen = cobsEncode(frame, len, encoded);
+  encoded[encodedLen++] = 0x00;
+
+  if (Serial.availableForWrite() < encodedLen)
+  {
+    return false;
+  }
+  Serial.write(encoded, encodedLen);
+  return true;
+}
+
+void telemetrySensorData(uint32_t now, SensorData sensorData, uint8_t runningMask)
+{
+  uint8_t payload[11];
+  uint8_t len = put32(payload, now);
+  payload[len++] = sensorData.temperature;
+  payload[len++] = sensorData.humidity;
+  payload[len++] = sensorData.light;
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    payload[len++] = sensorData.soilMoisture[i];
+  }
+  payload[len++] = runningMask;
+  telemetrySend(TELEMETRY_SENSOR_DATA, payload, len);
+}
+
+void telemetryPumpEvent(uint32_t now, uint8_t pumpIdx, bool running, uint16_t ml)
+{
+  uint8_t payload[8];
+  uint8_t len = put32(payload, now);
+  payload[len++] = pumpIdx;
+  payload[len++] = running;
+  len += put16(payload + len, ml);
+  telemetrySend(TELEMETRY_PUMP_EVENT, payload, len);
+}
+
+void telemetryFault(uint32_t now, uint8_t code, uint8_t runningMask)
+{
+  uint8_t payload[6];
+  uint8_t len = put32(payload, now);
+  payload[len++] = code;
+  payload[len++] = runningMask;
+  telemetrySend(TELEMETRY_FAULT, payload, len);
+}
+
+void telemetryConfig(Pump* pumps, uint8_t pumpsCount, SensorConfig sensorConfig)
+{
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+  for (uint8_t i = 0; i < pumpsCount; i++)
+  {
+    PumpConfig config = pumps[i].getConfig();
+    payload[0] = i;
+    memcpy(payload + 1, &config, sizeof(PumpConfig));
+    telemetrySend(TELEMETRY_PUMP_CONFIG, payload, 1 + sizeof(PumpConfig));
+    telemetryFlush();
+  }
+  memcpy(payload, &sensorConfig, sizeof(SensorConfig));
+  telemetrySend(TELEMETRY_SENSOR_CONFIG, payload, sizeof(SensorConfig));
+}
+
+bool telemetryReply(uint8_t command, uint8_t status, const uint8_t* data, uint8_t len)
+{
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+  if (len > TELEMETRY_MAX_PAYLOAD - 2)
+  {
+    return false;
+  }
+  payload[0] = command;
+  payload[1] = status;
+  memcpy(payload + 2, data, len);
+  return telemetrySend(COMMAND_REPLY, payload, len + 2);
+}
+
+bool telemetryReceive(uint8_t* type, uint8_t* payload, uint8_t* len)
+{
+  while (Serial.available() > 0)
+  {
+    uint8_t data = Serial.read();
+    if (data != 0x00)
+    {
+      if (rxLen < sizeof(rxBuffer))
+      {
+        rxBuffer[rxLen++] = data;
+      }
+      else
+      {
+        rxOverflow = true;
+      }
+      continue;
+    }
+
+    // End of frame, drop it if it's too big or corrupted
+    uint8_t frameLen = rxOverflow ? 0 : cobsDecode(rxBuffer, rxLen);
+    rxLen = 0;
+    rxOverflow = false;
+    if (frameLen < 4)
+    {
+      continue;
+    }
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < frameLen - 2; i++)
+    {
+      crc = crc16Update(crc, rxBuffer[i]);
+    }
+    if (crc != (rxBuffer[frameLen - 2] | (rxBuffer[frameLen - 1] << 8)))
+    {
+      continue;
+    }
+    *type = rxBuffer[0];
+    *len = frameLen - 4;
+    memcpy(payload, rxBuffer + 2, *len);
+    return true;
+  }
+  return false;
+}
+
+void telemetryFlush()
+{
+  Serial.flush();
+}
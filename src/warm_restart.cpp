@@ -0,0 +1,133 @@
+#include "warm_restart.h"
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
+#include <stddef.h>
+
+// MCUSR at reset. Optiboot clears it before starting the sketch and hands it over in r2 instead.
+static uint8_t bootloaderFlags __attribute__((section(".noinit")));
+static uint8_t resetFlags __attribute__((section(".noinit")));
+// Set by the watchdog interrupt, just before the timeout that resets
+#define WATCHDOG_MARK 0xA5
+static volatile uint8_t watchdogMark __attribute__((section(".noinit")));
+static bool watchdogTimeout __attribute__((section(".noinit")));
+
+/**
+ * First thing after the reset vector, r2 is still what the bootloader left.
+ */
+static void saveBootloaderFlags() __attribute__((naked, used, section(".init0")));
+static void saveBootloaderFlags()
+{
+  __asm__ __volatile__("sts %0, r2\n" : "=m"(bootloaderFlags) :);
+}
+
+/**
+ * Before the constructors and setup(). After a watchdog reset the watchdog stays on, with its
+ * shortest timeout, and would fire again in the middle of the boot.
+ */
+static void readResetFlags() __attribute__((naked, used, section(".init3")));
+static void readResetFlags()
+{
+  resetFlags = MCUSR ? MCUSR : bootloaderFlags;
+  MCUSR = 0;
+  wdt_disable();
+  // Only the low 4 bits exist, anything else is a bootloader that doesn't set r2
+  if (resetFlags & 0xF0)
+  {
+    resetFlags = 0;
+  }
+  watchdogTimeout = watchdogMark == WATCHDOG_MARK;
+  watchdogMark = 0;
+}
+
+ISR(WDT_vect)
+{
+  watchdogMark = WATCHDOG_MARK;
+}
+
+void warmWatchdogEnable()
+{
+  // Interrupt after 500 ms, reset 500 ms later: the same 1 s as without the warm restart
+  wdt_enable(WDTO_500MS);
+  WDTCSR |= _BV(WDIE);
+}
+
+void warmWatchdogReset()
+{
+  wdt_reset();
+  // The loop came back after all
+  watchdogMark = 0;
+  WDTCSR |= _BV(WDIE);
+}
+
+uint8_t warmResetFlags()
+{
+  return resetFlags;
+}
+
+static uint16_t warmAge(uint32_t uptimeMs, uint32_t ms)
+{
+  uint32_t ticks = (uptimeMs - ms) >> WARM_TICK_SHIFT;
+  return ticks > 0xFFFF ? 0xFFFF : ticks;
+}
+
+static uint32_t warmTime(uint32_t uptimeMs, uint16_t age)
+{
+  return uptimeMs - ((uint32_t)age << WARM_TICK_SHIFT);
+}
+
+void warmPackPump(WarmPump* warm, const PumpRuntime* runtime, uint32_t uptimeMs)
+{
+  warm->lastRunAge = warmAge(uptimeMs, runtime->lastRunMs);
+  warm->startedAge = warmAge(uptimeMs, runtime->startedAtMs);
+  warm->stoppedAge = warmAge(uptimeMs, runtime->stoppedAtMs);
+  warm->etUpdatedAge = warmAge(uptimeMs, runtime->etUpdatedMs);
+  warm->etElapsedMs = runtime->etElapsedMs;
+  warm->runSeconds = runtime->runSeconds;
+  warm->etFactor = runtime->etFactor;
+  warm->targetPulses = runtime->targetPulses;
+  warm->doseStartMoisture = runtime->doseStartMoisture;
+  warm->flags = (runtime->running ? WARM_PUMP_RUNNING : 0) | (runtime->settling ? WARM_PUMP_SETTLING : 0);
+}
+
+void warmUnpackPump(PumpRuntime* runtime, const WarmPump* warm, uint32_t uptimeMs)
+{
+  runtime->lastRunMs = warmTime(uptimeMs, warm->lastRunAge);
+  runtime->startedAtMs = warmTime(uptimeMs, warm->startedAge);
+  runtime->stoppedAtMs = warmTime(uptimeMs, warm->stoppedAge);
+  runtime->etUpdatedMs = warmTime(uptimeMs, warm->etUpdatedAge);
+  runtime->etElapsedMs = warm->etElapsedMs;
+  runtime->runSeconds = warm->runSeconds;
+  runtime->etFactor = warm->etFactor;
+  runtime->targetPulses = warm->targetPulses;
+  runtime->doseStartMoisture = warm->doseStartMoisture;
+  runtime->running = warm->flags & WARM_PUMP_RUNNING;
+  runtime->settling = warm->flags & WARM_PUMP_SETTLING;
+}
+
+static uint16_t warmStateCrc(const WarmState* state)
+{
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < offsetof(WarmState, crc); i++)
+  {
+    crc = _crc_ccitt_update(crc, ((const uint8_t*)state)[i]);
+  }
+  return crc;
+}
+
+bool warmStateIsValid(const WarmState* state)
+{
+  // A power on reset may come with BORF set too, the RAM is garbage then
+  bool watchdog = (resetFlags & _BV(WDRF)) && watchdogTimeout;
+  if (!(watchdog || (resetFlags & _BV(BORF))) || (resetFlags & (_BV(PORF) | _BV(EXTRF))))
+  {
+    return false;
+  }
+  return state->version == WARM_STATE_VERSION && state->restarts < WARM_MAX_RESTARTS &&
+         warmStateCrc(state) == state->crc;
+}
+
+void warmStateSeal(WarmState* state)
+{
+  state->crc = warmStateCrc(state);
+}
@@ -0,0 +1,137 @@
+#include "host_tool.h"
+
+#include <Arduino.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+/**
+ * tools/ from the project directory (where pio test runs), else next to this file.
+ */
+static void toolPath(const char *script, char *path, size_t size)
+{
+  snprintf(path, size, "tools/%s", script);
+  if (access(path, R_OK) == 0)
+  {
+    return;
+  }
+  const char *file = __FILE__;
+  const char *end = strstr(file, "test/test_desktop/");
+  snprintf(path, size, "%.*stools/%s", end ? (int)(end - file) : 0, file, script);
+}
+
+bool hostToolStart(HostTool *tool, const char *script, const char *const *args)
+{
+  memset(tool, 0, sizeof(HostTool));
+  tool->pid = -1;
+  tool->slave = -1;
+  tool->output = -1;
+  tool->pty = posix_openpt(O_RDWR | O_NOCTTY);
+  if (tool->pty < 0 || grantpt(tool->pty) < 0 || unlockpt(tool->pty) < 0)
+  {
+    return false;
+  }
+  const char *slaveName = ptsname(tool->pty);
+  tool->slave = open(slaveName, O_RDWR | O_NOCTTY);
+  if (tool->slave < 0)
+  {
+    return false;
+  }
+  struct termios attrs;
+  tcgetattr(tool->slave, &attrs);
+  cfmakeraw(&attrs);
+  tcsetattr(tool->slave, TCSANOW, &attrs);
+
+  int pipeFds[2];
+  if (pipe(pipeFds) < 0)
+  {
+    return false;
+  }
+  char path[512];
+  toolPath(script, path, sizeof(path));
+  const char *argv[16] = {"python3", path, slaveName};
+  uint8_t argc = 3;
+  while (args && *args && argc < 15)
+  {
+    argv[argc++] = *args++;
+  }
+  argv[argc] = NULL;
+
+  tool->pid = fork();
+  if (tool->pid == 0)
+  {
+    dup2(pipeFds[1], STDOUT_FILENO);
+    dup2(pipeFds[1], STDERR_FILENO);
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+    close(tool->pty);
+    close(tool->slave);
+    execvp(argv[0], (char *const *)argv);
+    _exit(127);
+  }
+  close(pipeFds[1]);
+  tool->output = pipeFds[0];
+  Serial.attach(tool->pty);
+  return tool->pid > 0;
+}
+
+bool hostToolReadLine(HostTool *tool, char *line, size_t size, int timeoutMs)
+{
+  while (true)
+  {
+    char *end = (char *)memchr(tool->buffer, '\n', tool->buffered);
+    if (end)
+    {
+      size_t len = end - tool->buffer;
+      size_t copy = len < size - 1 ? len : size - 1;
+      memcpy(line, tool->buffer, copy);
+      // The csv module ends its rows with \r\n
+      line[copy > 0 && line[copy - 1] == '\r' ? copy - 1 : copy] = '\0';
+      tool->buffered -= len + 1;
+      memmove(tool->buffer, end + 1, tool->buffered);
+      return true;
+    }
+    struct pollfd fd = {tool->output, POLLIN, 0};
+    if (tool->buffered == sizeof(tool->buffer) || poll(&fd, 1, timeoutMs) <= 0)
+    {
+      return false;
+    }
+    ssize_t count = read(tool->output, tool->buffer + tool->buffered, sizeof(tool->buffer) - tool->buffered);
+    if (count <= 0)
+    {
+      return false;
+    }
+    tool->buffered += count;
+  }
+}
+
+bool hostToolExited(HostTool *tool, int *status)
+{
+  int waitStatus;
+  if (tool->pid <= 0 || waitpid(tool->pid, &waitStatus, WNOHANG) != tool->pid)
+  {
+    return false;
+  }
+  tool->pid = -1;
+  *status = WIFEXITED(waitStatus) ? WEXITSTATUS(waitStatus) : -1;
+  return true;
+}
+
+void hostToolStop(HostTool *tool)
+{
+  if (tool->pid > 0)
+  {
+    kill(tool->pid, SIGTERM);
+    waitpid(tool->pid, NULL, 0);
+    tool->pid = -1;
+  }
+  Serial.attach(-1);
+  close(tool->output);
+  close(tool->slave);
+  close(tool->pty);
+}
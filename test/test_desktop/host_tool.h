@@ -0,0 +1,43 @@
+#ifndef HOST_TOOL_H
+#define HOST_TOOL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * One of the python tools (tools/) running against a pty, with Serial on the
+ * other end, so the firmware side of the link can be tested with the real host side.
+ */
+struct HostTool
+{
+  pid_t pid;
+  int pty;    // master side, Serial is attached to it
+  int slave;  // kept open so the pty survives the tool opening and closing it
+  int output; // stdout and stderr of the tool
+  char buffer[512];
+  size_t buffered;
+};
+
+/**
+ * Open a pty, attach Serial to it and start python3 tools/<script> <pty> args...
+ * args is NULL terminated.
+ */
+bool hostToolStart(HostTool *tool, const char *script, const char *const *args);
+
+/**
+ * Next line of the tool output (stdout and stderr), without the line ending.
+ * False if nothing came within timeoutMs or the output ended.
+ */
+bool hostToolReadLine(HostTool *tool, char *line, size_t size, int timeoutMs);
+
+/**
+ * True once the tool exited, its exit code goes to status (-1 if killed).
+ */
+bool hostToolExited(HostTool *tool, int *status);
+
+/**
+ * Kill the tool if still running, close the pty and detach Serial.
+ */
+void hostToolStop(HostTool *tool);
+
+#endif /* HOST_TOOL_H */
@@ -0,0 +1,425 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "commands.h"
+#include "configuration.h"
+#include "host_tool.h"
+#include "telemetry.h"
+
+#define CLI_TIMEOUT_MS 10000
+
+// The application side of commands.h, a unit without hardware
+Pump pumps[NUM_PUMPS] = {Pump(6), Pump(7), Pump(8)};
+SensorConfig sensorConfig;
+SensorData sensorData;
+
+// Admitted right away, no arbiter here
+void requestPump(uint8_t pumpIdx)
+{
+  pumps[pumpIdx].setStartedAtMs(0);
+  pumps[pumpIdx].setRunning(true);
+}
+
+void stopPump(uint8_t pumpIdx)
+{
+  pumps[pumpIdx].setRunning(false);
+}
+
+uint8_t pumpsRunningMask()
+{
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    mask |= pumps[i].isRunning() << i;
+  }
+  return mask;
+}
+
+// A latched leak, and whether the probe is still wet
+static bool faultLatched = false;
+static bool probeWet = false;
+
+bool faultActive()
+{
+  return faultLatched;
+}
+
+bool acknowledgeFault()
+{
+  if (probeWet)
+  {
+    return false;
+  }
+  faultLatched = false;
+  return true;
+}
+
+int readSoilSensorRaw(uint8_t pumpIdx)
+{
+  return 600 + pumpIdx;
+}
+
+int readLightSensorRaw()
+{
+  return 300;
+}
+
+// Pump 0 counted 125 pulses on its last run, the others have no meter
+uint16_t calibrateFlow(uint8_t pumpIdx, uint16_t ml)
+{
+  if (pumpIdx != 0)
+  {
+    return 0;
+  }
+  PumpConfig config = pumps[pumpIdx].getConfig();
+  config.flowUlPerPulse = ml * 1000ul / 125;
+  pumps[pumpIdx].setConfig(config);
+  return config.flowUlPerPulse;
+}
+
+// Cold boot from the reset button
+uint8_t bootState(uint8_t *state)
+{
+  state[0] = 0x02;
+  state[1] = false;
+  return 2;
+}
+
+// The soil curves as main.cpp keeps them, over the EEPROM of configuration.cpp
+static uint8_t soilCurvesCustom = 0;
+
+void setSensorConfig(SensorConfig config)
+{
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    if (config.soilSensorDryValue[i] != sensorConfig.soilSensorDryValue[i] ||
+        config.soilSensorWetValue[i] != sensorConfig.soilSensorWetValue[i])
+    {
+      resetSoilCurve(i);
+    }
+  }
+  sensorConfig = config;
+}
+
+void saveConfig()
+{
+  saveEEPROM(pumps, NUM_PUMPS, sensorConfig);
+  saveSoilCurvesCustom(soilCurvesCustom);
+}
+
+void soilCurve(uint8_t pumpIdx, uint8_t *knots)
+{
+  if (soilCurvesCustom & (1 << pumpIdx))
+  {
+    readSoilCurve(pumpIdx, knots);
+  }
+  else
+  {
+    soilCurveLinear(knots, sensorConfig.soilSensorDryValue[pumpIdx], sensorConfig.soilSensorWetValue[pumpIdx]);
+  }
+}
+
+void setSoilCurve(uint8_t pumpIdx, const uint8_t *knots)
+{
+  saveSoilCurve(pumpIdx, knots);
+  soilCurvesCustom |= 1 << pumpIdx;
+}
+
+void resetSoilCurve(uint8_t pumpIdx)
+{
+  soilCurvesCustom &= ~(1 << pumpIdx);
+}
+
+/**
+ * Run tools/plant_cli.py <pty> args..., answering its commands until it exits.
+ * Its whole output goes to output, returns its exit code.
+ */
+static int runCli(const char *const *args, char *output, size_t size)
+{
+  HostTool tool;
+  TEST_ASSERT_TRUE(hostToolStart(&tool, "plant_cli.py", args));
+
+  uint8_t type, len;
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+  int status = -1;
+  uint16_t idleMs = 0;
+  while (!hostToolExited(&tool, &status) && idleMs < CLI_TIMEOUT_MS)
+  {
+    if (telemetryReceive(&type, payload, &len))
+    {
+      handleCommand(1000, type, payload, len);
+      idleMs = 0;
+    }
+    else
+    {
+      usleep(1000);
+      idleMs++;
+    }
+  }
+
+  char line[256];
+  output[0] = '\0';
+  while (hostToolReadLine(&tool, line, sizeof(line), 0) && strlen(output) + strlen(line) + 2 < size)
+  {
+    strcat(output, line);
+    strcat(output, "\n");
+  }
+  hostToolStop(&tool);
+  TEST_ASSERT_TRUE_MESSAGE(idleMs < CLI_TIMEOUT_MS, "plant_cli.py hung");
+  return status;
+}
+
+static void writeFile(const char *path, const char *text)
+{
+  FILE *file = fopen(path, "w");
+  TEST_ASSERT_NOT_NULL(file);
+  fputs(text, file);
+  fclose(file);
+}
+
+/**
+ * Replace the first from by to in text (which has room for it).
+ */
+static void replace(char *text, const char *from, const char *to)
+{
+  char *at = strstr(text, from);
+  TEST_ASSERT_NOT_NULL(at);
+  memmove(at + strlen(to), at + strlen(from), strlen(at + strlen(from)) + 1);
+  memcpy(at, to, strlen(to));
+}
+
+static void resetUnit()
+{
+  for (uint8_t i = 0; i < NUM_PUMPS; i++)
+  {
+    pumps[i].setConfig(Pump(0).getConfig());
+    pumps[i].setRunning(false);
+    sensorConfig.soilSensorDryValue[i] = 800;
+    sensorConfig.soilSensorWetValue[i] = 400;
+  }
+  faultLatched = false;
+  probeWet = false;
+  soilCurvesCustom = 0;
+  sensorConfig.lightSensorDayValue = 900;
+  sensorConfig.lightSensorNightValue = 100;
+  PumpConfig config = pumps[1].getConfig();
+  config.frequency = 45;
+  pumps[1].setConfig(config);
+  saveEEPROM(pumps, NUM_PUMPS, sensorConfig);
+}
+
+static void test_cli_config_round_trip()
+{
+  const char *getArgs[] = {"get-config", NULL};
+  char path[] = "/tmp/plant_cli_XXXXXX";
+  const char *pushArgs[] = {"push-config", path, NULL};
+  char config[2048];
+  char output[2048];
+  resetUnit();
+
+  TEST_ASSERT_EQUAL_INT(0, runCli(getArgs, config, sizeof(config)));
+  TEST_ASSERT_NOT_NULL(strstr(config, "\"frequency\": 45,"));
+  TEST_ASSERT_NOT_NULL(strstr(config, "\"lightSensorDayValue\": 900,"));
+
+  // Through WRITE_CONFIG chunks and COMMIT_CONFIG
+  replace(config, "\"frequency\": 45,", "\"frequency\": 120,");
+  replace(config, "\"lightSensorDayValue\": 900,", "\"lightSensorDayValue\": 850,");
+  close(mkstemp(path));
+  writeFile(path, config);
+  TEST_ASSERT_EQUAL_INT(0, runCli(pushArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_INT(120, pumps[1].getConfig().frequency);
+  TEST_ASSERT_EQUAL_INT(30, pumps[0].getConfig().frequency);
+  TEST_ASSERT_EQUAL_INT(850, sensorConfig.lightSensorDayValue);
+
+  // Saved as well
+  EEPROM_MEM mem;
+  EEPROM.readBlock(0, mem);
+  TEST_ASSERT_EQUAL_INT(120, mem.pumpConfigs[1].frequency);
+  TEST_ASSERT_EQUAL_INT(850, mem.sensorConfig.lightSensorDayValue);
+  unlink(path);
+}
+
+static void test_cli_config_out_of_range_rejected()
+{
+  const char *getArgs[] = {"get-config", NULL};
+  char path[] = "/tmp/plant_cli_XXXXXX";
+  const char *pushArgs[] = {"push-config", path, NULL};
+  char config[2048];
+  char output[2048];
+  resetUnit();
+
+  TEST_ASSERT_EQUAL_INT(0, runCli(getArgs, config, sizeof(config)));
+  replace(config, "\"frequency\": 45,", "\"frequency\": 2000,");
+  close(mkstemp(path));
+  writeFile(path, config);
+  TEST_ASSERT_EQUAL_INT(1, runCli(pushArgs, output, sizeof(output)));
+  TEST_ASSERT_NOT_NULL(strstr(output, "commit config failed: invalid config"));
+
+  // Nothing applied nor saved
+  TEST_ASSERT_EQUAL_INT(45, pumps[1].getConfig().frequency);
+  EEPROM_MEM mem;
+  EEPROM.readBlock(0, mem);
+  TEST_ASSERT_EQUAL_INT(45, mem.pumpConfigs[1].frequency);
+  unlink(path);
+}
+
+static void test_cli_start_stop()
+{
+  const char *startArgs[] = {"start", "2", NULL};
+  const char *stopArgs[] = {"stop", "2", NULL};
+  const char *badArgs[] = {"start", "3", NULL};
+  char output[512];
+  resetUnit();
+
+  TEST_ASSERT_EQUAL_INT(0, runCli(startArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_UINT8(0x04, pumpsRunningMask());
+  TEST_ASSERT_EQUAL_INT(0, runCli(stopArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_UINT8(0, pumpsRunningMask());
+
+  TEST_ASSERT_EQUAL_INT(1, runCli(badArgs, output, sizeof(output)));
+  TEST_ASSERT_NOT_NULL(strstr(output, "start failed: bad request"));
+  TEST_ASSERT_EQUAL_UINT8(0, pumpsRunningMask());
+}
+
+static void test_cli_start_refused_during_fault()
+{
+  const char *startArgs[] = {"start", "0", NULL};
+  const char *stateArgs[] = {"state", NULL};
+  const char *ackArgs[] = {"ack", NULL};
+  char output[1024];
+  resetUnit();
+  faultLatched = true;
+  probeWet = true;
+
+  TEST_ASSERT_EQUAL_INT(1, runCli(startArgs, output, sizeof(output)));
+  TEST_ASSERT_NOT_NULL(strstr(output, "start failed: fault still active"));
+  TEST_ASSERT_EQUAL_UINT8(0, pumpsRunningMask());
+  TEST_ASSERT_EQUAL_INT(0, runCli(stateArgs, output, sizeof(output)));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"fault\": true"));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"external\""));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"warm_boot\": false"));
+
+  // Refused while the probe is wet, then the pumps can start again
+  TEST_ASSERT_EQUAL_INT(1, runCli(ackArgs, output, sizeof(output)));
+  TEST_ASSERT_NOT_NULL(strstr(output, "acknowledge fault failed: fault still active"));
+  probeWet = false;
+  TEST_ASSERT_EQUAL_INT(0, runCli(ackArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_INT(0, runCli(startArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_UINT8(0x01, pumpsRunningMask());
+}
+
+static void test_cli_faults()
+{
+  const char *args[] = {"faults", NULL};
+  char output[1024];
+  resetUnit();
+  EEPROM.updateByte(EEPROM_FAULTS_ADDR, 0xFF);
+  logFault(FAULT_LEAK, 70000, 0x02);
+
+  TEST_ASSERT_EQUAL_INT(0, runCli(args, output, sizeof(output)));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"total\": 1,"));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"uptime_ms\": 70000,"));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"code\": \"leak\","));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"running\": 2"));
+}
+
+static void test_cli_calibrate()
+{
+  const char *args[] = {"calibrate", "wet", "1", NULL};
+  char output[512];
+  resetUnit();
+
+  TEST_ASSERT_EQUAL_INT(0, runCli(args, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_STRING("601\n", output);
+  TEST_ASSERT_EQUAL_INT(601, sensorConfig.soilSensorWetValue[1]);
+}
+
+static void test_cli_calibrate_flow()
+{
+  const char *args[] = {"calibrate", "flow", "0", "--ml", "250", NULL};
+  const char *noMeterArgs[] = {"calibrate", "flow", "2", "--ml", "250", NULL};
+  char output[512];
+  resetUnit();
+
+  TEST_ASSERT_EQUAL_INT(0, runCli(args, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_STRING("2000\n", output);
+  TEST_ASSERT_EQUAL_UINT16(2000, pumps[0].getConfig().flowUlPerPulse);
+  TEST_ASSERT_NOT_EQUAL(0, runCli(noMeterArgs, output, sizeof(output)));
+}
+
+static void test_cli_doses()
+{
+  const char *args[] = {"doses", NULL};
+  char output[1024];
+  resetUnit();
+  for (uint8_t i = 0; i < DOSE_LOG_SIZE; i++)
+  {
+    EEPROM.updateBlock(EEPROM_DOSES_ADDR + i * sizeof(DoseRecord), (DoseRecord){0, 0, 0, DOSE_EMPTY, 0});
+  }
+
+  TEST_ASSERT_EQUAL_INT(0, runCli(args, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_STRING("[]\n", output);
+
+  logDose(1, 60000, 30, 480);
+  logDose(0, 90000, 12, 250);
+  TEST_ASSERT_EQUAL_INT(0, runCli(args, output, sizeof(output)));
+  const char *first = strstr(output, "\"uptime_ms\": 60000,");
+  const char *second = strstr(output, "\"uptime_ms\": 90000,");
+  TEST_ASSERT_NOT_NULL(first);
+  TEST_ASSERT_NOT_NULL(second);
+  TEST_ASSERT_TRUE(first < second);
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"ml\": 480"));
+  TEST_ASSERT_NOT_NULL(strstr(output, "\"seconds\": 12,"));
+}
+
+static void test_cli_soil_curve()
+{
+  char path[] = "/tmp/plant_cli_XXXXXX";
+  const char *getArgs[] = {"get-curve", "2", NULL};
+  const char *setArgs[] = {"set-curve", "2", path, NULL};
+  const char *wetArgs[] = {"calibrate", "wet", "2", NULL};
+  char output[512];
+  resetUnit();
+  close(mkstemp(path));
+
+  // Without a curve, the dry/wet line: 800 -> 0%, 400 -> 100%
+  TEST_ASSERT_EQUAL_INT(0, runCli(getArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_STRING("{\"knots\": [100, 100, 100, 100, 100, 100, 100, 88, 72, 56, 40, 24, 8, 0, 0, 0, 0]}\n", output);
+
+  // Not monotonic
+  writeFile(path, "{\"knots\": [100, 100, 100, 100, 100, 100, 95, 90, 80, 85, 50, 30, 20, 10, 5, 0, 0]}");
+  TEST_ASSERT_NOT_EQUAL(0, runCli(setArgs, output, sizeof(output)));
+  TEST_ASSERT_NOT_NULL(strstr(output, "set curve failed"));
+
+  writeFile(path, "{\"knots\": [100, 100, 100, 100, 100, 100, 95, 90, 80, 65, 50, 30, 20, 10, 5, 0, 0]}");
+  TEST_ASSERT_EQUAL_INT(0, runCli(setArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_INT(0, runCli(getArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_STRING("{\"knots\": [100, 100, 100, 100, 100, 100, 95, 90, 80, 65, 50, 30, 20, 10, 5, 0, 0]}\n", output);
+  // Stored right away
+  TEST_ASSERT_EQUAL_UINT8(0x04, loadSoilCurves());
+
+  // Recalibrating puts the probe back on a line, in the EEPROM once saved
+  TEST_ASSERT_EQUAL_INT(0, runCli(wetArgs, output, sizeof(output)));
+  TEST_ASSERT_EQUAL_INT(0, runCli(getArgs, output, sizeof(output)));
+  TEST_ASSERT_NULL(strstr(output, "95, 90, 80, 65"));
+  TEST_ASSERT_EQUAL_UINT8(0x04, loadSoilCurves());
+  saveConfig();
+  TEST_ASSERT_EQUAL_UINT8(0, loadSoilCurves());
+  unlink(path);
+}
+
+void runCommandsTests()
+{
+  RUN_TEST(test_cli_config_round_trip);
+  RUN_TEST(test_cli_config_out_of_range_rejected);
+  RUN_TEST(test_cli_start_stop);
+  RUN_TEST(test_cli_start_refused_during_fault);
+  RUN_TEST(test_cli_faults);
+  RUN_TEST(test_cli_calibrate);
+  RUN_TEST(test_cli_calibrate_flow);
+  RUN_TEST(test_cli_doses);
+  RUN_TEST(test_cli_soil_curve);
+}
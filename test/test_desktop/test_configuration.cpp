@@ -0,0 +1,124 @@
+#include <unity.h>
+
+#include "configuration.h"
+
+static void checkSaved(const PumpConfig *expected)
+{
+  EEPROM_MEM mem;
+  EEPROM.readBlock(0, mem);
+  TEST_ASSERT_EQUAL_HEX8(EEPROM_MEM_MAGIC, mem.magic);
+  TEST_ASSERT_EQUAL_UINT8(EEPROM_MEM_VERSION, mem.version);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, &mem.pumpConfigs[0], sizeof(PumpConfig));
+}
+
+static void test_baseline_image_migrated()
+{
+  // 90 min reads as the magic byte, followed by version 0
+  EEPROM_MEM_V0 v0 = {{{90, 45, 60, 40, 20}, {30, 30, 80, 60, 60}, {1440, 300, 100, 100, 0}},
+                      {900, 100, {700, 710, 720}, {300, 310, 320}}};
+  EEPROM.updateBlock(0, v0);
+  Pump units[3] = {Pump(6), Pump(7), Pump(8)};
+  SensorConfig sensorConfig;
+
+  loadEEPROM(units, 3, &sensorConfig);
+
+  PumpConfig config = units[0].getConfig();
+  TEST_ASSERT_EQUAL_INT(90, config.frequency);
+  TEST_ASSERT_EQUAL_INT(45, config.secondsPump);
+  TEST_ASSERT_EQUAL_INT(60, config.power);
+  TEST_ASSERT_EQUAL_UINT8(40, config.soilSensor);
+  TEST_ASSERT_EQUAL_UINT8(20, config.lightSensor);
+  TEST_ASSERT_EQUAL_UINT8(DEFAULT_PUMP_MODE, config.mode);
+  TEST_ASSERT_EQUAL_UINT8(0, config.doseGain);
+  TEST_ASSERT_EQUAL_INT(1440, units[2].getConfig().frequency);
+  TEST_ASSERT_EQUAL_INT(300, units[2].getConfig().secondsPump);
+  TEST_ASSERT_EQUAL_INT(900, sensorConfig.lightSensorDayValue);
+  TEST_ASSERT_EQUAL_INT(100, sensorConfig.lightSensorNightValue);
+  TEST_ASSERT_EQUAL_INT(720, sensorConfig.soilSensorDryValue[2]);
+  TEST_ASSERT_EQUAL_INT(310, sensorConfig.soilSensorWetValue[1]);
+  // Written back in the current layout
+  checkSaved(&config);
+}
+
+static void test_v1_image_migrated()
+{
+  EEPROM_MEM_V1 v1 = {EEPROM_MEM_MAGIC, 1,
+                      {{60, 20, 70, 40, 20, PUMP_MODE_ADAPTIVE, 35}, {30, 30, 80, 60, 60, 0, 0}, {1440, 300, 100, 100, 0, 0, 0}},
+                      {900, 100, {700, 710, 720}, {300, 310, 320}}};
+  EEPROM.updateBlock(0, v1);
+  Pump units[3] = {Pump(6), Pump(7), Pump(8)};
+  SensorConfig sensorConfig;
+
+  loadEEPROM(units, 3, &sensorConfig);
+
+  PumpConfig config = units[0].getConfig();
+  TEST_ASSERT_EQUAL_INT(60, config.frequency);
+  TEST_ASSERT_EQUAL_INT(20, config.secondsPump);
+  TEST_ASSERT_EQUAL_UINT8(PUMP_MODE_ADAPTIVE, config.mode);
+  TEST_ASSERT_EQUAL_UINT8(35, config.doseGain);
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_DOSE_ML, config.doseMl);
+  TEST_ASSERT_EQUAL_UINT16(DEFAULT_FLOW_UL_PER_PULSE, config.flowUlPerPulse);
+  TEST_ASSERT_EQUAL_INT(300, units[2].getConfig().secondsPump);
+  TEST_ASSERT_EQUAL_INT(310, sensorConfig.soilSensorWetValue[1]);
+  checkSaved(&config);
+}
+
+static void test_blank_eeprom_gets_defaults()
+{
+  memset(EEPROM.bytes, 0xFF, sizeof(EEPROM.bytes));
+  Pump units[3] = {Pump(6), Pump(7), Pump(8)};
+  SensorConfig sensorConfig;
+
+  loadEEPROM(units, 3, &sensorConfig);
+
+  PumpConfig config = units[1].getConfig();
+  TEST_ASSERT_EQUAL_INT(DEFAULT_FREQUENCY, config.frequency);
+  TEST_ASSERT_EQUAL_INT(DEFAULT_SECONDS_PUMP, config.secondsPump);
+  TEST_ASSERT_EQUAL_INT(DEFAULT_SOIL_SENSOR_DRY_VALUE, sensorConfig.soilSensorDryValue[0]);
+  TEST_ASSERT_EQUAL_INT(DEFAULT_LIGHT_SENSOR_NIGHT_VALUE, sensorConfig.lightSensorNightValue);
+  checkSaved(&config);
+}
+
+static void test_current_image_kept()
+{
+  Pump units[3] = {Pump(6), Pump(7), Pump(8)};
+  SensorConfig sensorConfig = {800, 200, {600, 600, 600}, {250, 250, 250}};
+  units[2].incFrequency(true);
+  saveEEPROM(units, 3, sensorConfig);
+  Pump loaded[3] = {Pump(6), Pump(7), Pump(8)};
+  SensorConfig loadedSensorConfig;
+
+  loadEEPROM(loaded, 3, &loadedSensorConfig);
+
+  TEST_ASSERT_EQUAL_INT(units[2].getConfig().frequency, loaded[2].getConfig().frequency);
+  TEST_ASSERT_EQUAL_INT(800, loadedSensorConfig.lightSensorDayValue);
+  TEST_ASSERT_EQUAL_INT(250, loadedSensorConfig.soilSensorWetValue[2]);
+}
+
+static void test_dose_log_wraps()
+{
+  memset(EEPROM.bytes, 0xFF, sizeof(EEPROM.bytes));
+  DoseRecord record;
+  TEST_ASSERT_EQUAL_UINT8(0, loadDose(0, &record));
+
+  // Round the ring 26 times, past the wrap of the sequence numbers
+  for (uint16_t run = 0; run < 26 * DOSE_LOG_SIZE + 3; run++)
+  {
+    logDose(run % 3, run * 1000ul, 30, run);
+  }
+
+  TEST_ASSERT_EQUAL_UINT8(DOSE_LOG_SIZE, loadDose(0, &record));
+  TEST_ASSERT_EQUAL_UINT16(25 * DOSE_LOG_SIZE + 3, record.ml);
+  loadDose(DOSE_LOG_SIZE - 1, &record);
+  TEST_ASSERT_EQUAL_UINT16(26 * DOSE_LOG_SIZE + 2, record.ml);
+  TEST_ASSERT_EQUAL_UINT8((26 * DOSE_LOG_SIZE + 2) % 3, record.pump);
+}
+
+void runConfigurationTests()
+{
+  RUN_TEST(test_baseline_image_migrated);
+  RUN_TEST(test_v1_image_migrated);
+  RUN_TEST(test_blank_eeprom_gets_defaults);
+  RUN_TEST(test_current_image_kept);
+  RUN_TEST(test_dose_log_wraps);
+}
@@ -0,0 +1,112 @@
+#include <unity.h>
+
+#include "framing.h"
+
+#define TEST_MAX_LEN 600
+
+static uint8_t input[TEST_MAX_LEN];
+static uint8_t encoded[COBS_ENCODED_SIZE(TEST_MAX_LEN)];
+
+/**
+ * Encode and decode len bytes of input, checking the encoding has no 0x00
+ * and stays within COBS_ENCODED_SIZE().
+ */
+static void checkRoundTrip(uint16_t len)
+{
+  uint16_t encodedLen = cobsEncode(input, len, encoded);
+  TEST_ASSERT_LESS_OR_EQUAL(COBS_ENCODED_SIZE(len), encodedLen);
+  for (uint16_t i = 0; i < encodedLen; i++)
+  {
+    TEST_ASSERT_TRUE(encoded[i] != 0);
+  }
+  TEST_ASSERT_EQUAL_UINT16(len, cobsDecode(encoded, encodedLen));
+  if (len > 0)
+  {
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(input, encoded, len);
+  }
+}
+
+static void fill(uint16_t len, uint8_t zeroEvery)
+{
+  for (uint16_t i = 0; i < len; i++)
+  {
+    input[i] = (zeroEvery && i % zeroEvery == 0) ? 0 : (i % 255) + 1;
+  }
+}
+
+static void test_crc16_check_value()
+{
+  const char* check = "123456789";
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; check[i]; i++)
+  {
+    crc = crc16Update(crc, check[i]);
+  }
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, crc);
+}
+
+static void test_cobs_known_encoding()
+{
+  const uint8_t in[] = {0x11, 0x00, 0x00, 0x22, 0x33, 0x00};
+  const uint8_t expected[] = {0x02, 0x11, 0x01, 0x03, 0x22, 0x33, 0x01};
+  TEST_ASSERT_EQUAL_UINT16(sizeof(expected), cobsEncode(in, sizeof(in), encoded));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, encoded, sizeof(expected));
+}
+
+static void test_cobs_round_trip_with_zeros()
+{
+  const uint16_t lens[] = {0, 1, 2, 36, 253};
+  for (uint8_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+  {
+    fill(lens[i], 3);
+    checkRoundTrip(lens[i]);
+    fill(lens[i], 1); // Only zeros
+    checkRoundTrip(lens[i]);
+  }
+}
+
+static void test_cobs_round_trip_long_frames()
+{
+  // Around the 254 bytes block limit, with and without a zero to split the blocks
+  const uint16_t lens[] = {253, 254, 255, 256, 300, 508, 509, TEST_MAX_LEN};
+  for (uint8_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+  {
+    fill(lens[i], 0);
+    checkRoundTrip(lens[i]);
+    fill(lens[i], 200);
+    checkRoundTrip(lens[i]);
+  }
+}
+
+static void test_cobs_full_block()
+{
+  // 254 non zero bytes are a single 0xFF block, without a trailing code
+  fill(254, 0);
+  TEST_ASSERT_EQUAL_UINT16(255, cobsEncode(input, 254, encoded));
+  TEST_ASSERT_EQUAL_UINT8(0xFF, encoded[0]);
+
+  // One more byte starts a new block
+  fill(255, 0);
+  TEST_ASSERT_EQUAL_UINT16(257, cobsEncode(input, 255, encoded));
+  TEST_ASSERT_EQUAL_UINT8(0xFF, encoded[0]);
+  TEST_ASSERT_EQUAL_UINT8(0x02, encoded[255]);
+}
+
+static void test_cobs_decode_malformed()
+{
+  uint8_t zeroCode[] = {0x02, 0x11, 0x00, 0x22};
+  TEST_ASSERT_EQUAL_UINT16(0, cobsDecode(zeroCode, sizeof(zeroCode)));
+
+  uint8_t truncated[] = {0x05, 0x11, 0x22};
+  TEST_ASSERT_EQUAL_UINT16(0, cobsDecode(truncated, sizeof(truncated)));
+}
+
+void runFramingTests()
+{
+  RUN_TEST(test_crc16_check_value);
+  RUN_TEST(test_cobs_known_encoding);
+  RUN_TEST(test_cobs_round_trip_with_zeros);
+  RUN_TEST(test_cobs_round_trip_long_frames);
+  RUN_TEST(test_cobs_full_block);
+  RUN_TEST(test_cobs_decode_malformed);
+}
@@ -0,0 +1,157 @@
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+
+#include "history.h"
+
+#define STEP (1 << HISTORY_DELTA_SHIFT)
+
+static History history;
+static uint8_t out[HISTORY_SAMPLES + 1];
+
+static void pushAll(uint8_t value)
+{
+  uint8_t values[HISTORY_CHANNELS];
+  for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+  {
+    values[i] = value;
+  }
+  historyPush(&history, values);
+}
+
+static void test_history_round_trip()
+{
+  historyClear(&history);
+  TEST_ASSERT_TRUE(historyIsValid(&history));
+  TEST_ASSERT_EQUAL_UINT8(0, historyRead(&history, HISTORY_LIGHT, out));
+
+  // Slow changes within the delta range come back within half a step
+  uint8_t values[] = {100, 104, 110, 96, 97, 81, 85, 100};
+  for (uint8_t i = 0; i < sizeof(values); i++)
+  {
+    pushAll(values[i]);
+  }
+  for (uint8_t channel = 0; channel < HISTORY_CHANNELS; channel++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(sizeof(values), historyRead(&history, channel, out));
+    for (uint8_t i = 0; i < sizeof(values); i++)
+    {
+      TEST_ASSERT_UINT8_WITHIN(STEP / 2, values[i], out[i]);
+    }
+  }
+}
+
+static void test_history_saturates_big_changes()
+{
+  historyClear(&history);
+  pushAll(100);
+  pushAll(200); // Beyond +7 steps
+  pushAll(200);
+  pushAll(0); // Beyond -8 steps
+
+  historyRead(&history, HISTORY_SOIL, out);
+  TEST_ASSERT_EQUAL_UINT8(100, out[0]);
+  TEST_ASSERT_EQUAL_UINT8(100 + 7 * STEP, out[1]);
+  // Followed over the next samples instead of being lost
+  TEST_ASSERT_EQUAL_UINT8(100 + 14 * STEP, out[2]);
+  TEST_ASSERT_EQUAL_UINT8(100 + 6 * STEP, out[3]);
+}
+
+static void test_history_stays_in_range_at_the_edges()
+{
+  historyClear(&history);
+  pushAll(3);
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    pushAll(0);
+  }
+  uint8_t count = historyRead(&history, HISTORY_HUMIDITY, out);
+  TEST_ASSERT_UINT8_WITHIN(STEP, 0, out[count - 1]);
+
+  historyClear(&history);
+  pushAll(250);
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    pushAll(255);
+  }
+  count = historyRead(&history, HISTORY_HUMIDITY, out);
+  // Doesn't wrap around to 0
+  TEST_ASSERT_UINT8_WITHIN(STEP, 255, out[count - 1]);
+}
+
+static void test_history_drops_the_oldest_when_full()
+{
+  historyClear(&history);
+  for (uint8_t i = 0; i < HISTORY_SAMPLES + 11; i++)
+  {
+    pushAll(50 + i * STEP);
+  }
+  TEST_ASSERT_TRUE(historyIsValid(&history));
+  TEST_ASSERT_EQUAL_UINT8(HISTORY_SAMPLES + 1, historyRead(&history, HISTORY_TEMPERATURE, out));
+  for (uint8_t i = 0; i <= HISTORY_SAMPLES; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(50 + (i + 10) * STEP, out[i]);
+  }
+}
+
+static void test_history_rejects_corrupted()
+{
+  historyClear(&history);
+  history.count = HISTORY_SAMPLES + 2;
+  TEST_ASSERT_FALSE(historyIsValid(&history));
+  historyClear(&history);
+  history.magic = 0;
+  TEST_ASSERT_FALSE(historyIsValid(&history));
+}
+
+/**
+ * Not a pass/fail test: prints the storage cost and the encoding speed.
+ */
+static void test_history_benchmark()
+{
+  const uint32_t pushes = 200000;
+  char message[96];
+
+  snprintf(message, sizeof(message), "%u bytes, %.2f bytes per sample (raw: 1)", (unsigned)sizeof(History),
+           (double)sizeof(History) / ((HISTORY_SAMPLES + 1) * HISTORY_CHANNELS));
+  TEST_MESSAGE(message);
+
+  uint8_t values[HISTORY_CHANNELS];
+  historyClear(&history);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < pushes; i++)
+  {
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+    {
+      values[c] = (i * (c + 1)) & 0xFF;
+    }
+    historyPush(&history, values);
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  snprintf(message, sizeof(message), "push: %.1f ns per sample of %d channels (host)", elapsed.count() / pushes,
+           HISTORY_CHANNELS);
+  TEST_MESSAGE(message);
+
+  start = std::chrono::steady_clock::now();
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < pushes / HISTORY_SAMPLES; i++)
+  {
+    sum += historyRead(&history, i % HISTORY_CHANNELS, out);
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+  snprintf(message, sizeof(message), "read: %.1f ns per channel of %u values", elapsed.count() / (pushes / HISTORY_SAMPLES),
+           (unsigned)sum / (pushes / HISTORY_SAMPLES));
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_TRUE(historyIsValid(&history));
+}
+
+void runHistoryTests()
+{
+  RUN_TEST(test_history_round_trip);
+  RUN_TEST(test_history_saturates_big_changes);
+  RUN_TEST(test_history_stays_in_range_at_the_edges);
+  RUN_TEST(test_history_drops_the_oldest_when_full);
+  RUN_TEST(test_history_rejects_corrupted);
+  RUN_TEST(test_history_benchmark);
+}
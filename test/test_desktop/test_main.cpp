@@ -0,0 +1,29 @@
+#include <unity.h>
+
+// One function per module, each running its RUN_TEST()s
+void runFramingTests();
+void runTelemetryTests();
+void runCommandsTests();
+void runConfigurationTests();
+void runHistoryTests();
+void runPumpArbiterTests();
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  runFramingTests();
+  runTelemetryTests();
+  runCommandsTests();
+  runConfigurationTests();
+  runHistoryTests();
+  runPumpArbiterTests();
+  return UNITY_END();
+}
@@ -0,0 +1,187 @@
+#include <unity.h>
+
+#include "pump_arbiter.h"
+
+#define TEST_PUMPS 4
+
+static PumpArbiter arbiter;
+static Pump pumps[TEST_PUMPS] = {Pump(3), Pump(5), Pump(6), Pump(11)};
+
+static void setPower(uint8_t pumpIdx, int power)
+{
+  PumpConfig config = pumps[pumpIdx].getConfig();
+  config.power = power;
+  pumps[pumpIdx].setConfig(config);
+}
+
+static void resetPumps()
+{
+  arbiterBegin(&arbiter);
+  for (uint8_t i = 0; i < TEST_PUMPS; i++)
+  {
+    pumps[i].stop(0);
+    setPower(i, 10);
+  }
+}
+
+/**
+ * Admit the next pump at now and start it, like runPumps() does.
+ */
+static uint8_t admit(uint32_t now)
+{
+  uint8_t pumpIdx = arbiterNext(&arbiter, pumps, TEST_PUMPS, now);
+  if (pumpIdx != ARBITER_NONE)
+  {
+    pumps[pumpIdx].start(now, 50);
+  }
+  return pumpIdx;
+}
+
+static void test_arbiter_queue()
+{
+  resetPumps();
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_NONE, arbiterNext(&arbiter, pumps, TEST_PUMPS, 0));
+
+  TEST_ASSERT_TRUE(arbiterRequest(&arbiter, 2));
+  TEST_ASSERT_TRUE(arbiterRequest(&arbiter, 0));
+  TEST_ASSERT_FALSE(arbiterRequest(&arbiter, 2)); // Already queued
+  TEST_ASSERT_TRUE(arbiterIsQueued(&arbiter, 0));
+  TEST_ASSERT_FALSE(arbiterIsQueued(&arbiter, 1));
+  TEST_ASSERT_EQUAL_UINT8(0x05, arbiterQueuedMask(&arbiter));
+
+  arbiterCancel(&arbiter, 2);
+  TEST_ASSERT_EQUAL_UINT8(0x01, arbiterQueuedMask(&arbiter));
+
+  for (uint8_t i = 1; i < ARBITER_QUEUE_SIZE; i++)
+  {
+    TEST_ASSERT_TRUE(arbiterRequest(&arbiter, i));
+  }
+  TEST_ASSERT_FALSE(arbiterRequest(&arbiter, ARBITER_QUEUE_SIZE)); // Full
+}
+
+static void test_arbiter_fifo_order()
+{
+  resetPumps();
+  const uint8_t order[] = {3, 1, 0, 2};
+  for (uint8_t i = 0; i < TEST_PUMPS; i++)
+  {
+    arbiterRequest(&arbiter, order[i]);
+  }
+
+  uint32_t now = 0;
+  for (uint8_t i = 0; i < TEST_PUMPS; i++)
+  {
+    // Back to back, in the order they were queued
+    TEST_ASSERT_EQUAL_UINT8(order[i], admit(now));
+    now += ARBITER_SOFT_START_MS * 5;
+    pumps[order[i]].stop(now);
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, arbiterQueuedMask(&arbiter));
+}
+
+static void test_arbiter_max_pumps()
+{
+  resetPumps();
+  for (uint8_t i = 0; i < TEST_PUMPS; i++)
+  {
+    arbiterRequest(&arbiter, i);
+  }
+
+  uint32_t now = 0;
+  for (uint8_t i = 0; i < ARBITER_MAX_PUMPS; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(i, admit(now));
+    now += ARBITER_SOFT_START_MS;
+  }
+  // Well within the power budget, but as many running as allowed
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_NONE, admit(now + 60000));
+  pumps[0].stop(now + 60000);
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_MAX_PUMPS, admit(now + 60000));
+}
+
+static void test_arbiter_power_budget()
+{
+  resetPumps();
+  setPower(0, MAX_PUMP_POWER);
+  setPower(1, 1);
+  arbiterRequest(&arbiter, 0);
+  arbiterRequest(&arbiter, 1);
+
+  // Alone, a pump gets admitted whatever its power
+  TEST_ASSERT_EQUAL_UINT8(0, admit(0));
+  // Even the smallest one doesn't fit next to it
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_NONE, admit(ARBITER_SOFT_START_MS * 10));
+  pumps[0].stop(ARBITER_SOFT_START_MS * 10);
+  TEST_ASSERT_EQUAL_UINT8(1, admit(ARBITER_SOFT_START_MS * 10));
+
+#if ARBITER_MAX_PUMPS > 1
+  // Two pumps sharing the budget
+  resetPumps();
+  setPower(0, ARBITER_MAX_POWER / 2);
+  setPower(1, ARBITER_MAX_POWER / 2);
+  setPower(2, 1);
+  arbiterRequest(&arbiter, 0);
+  arbiterRequest(&arbiter, 1);
+  arbiterRequest(&arbiter, 2);
+  TEST_ASSERT_EQUAL_UINT8(0, admit(0));
+  TEST_ASSERT_EQUAL_UINT8(1, admit(ARBITER_SOFT_START_MS));
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_NONE, admit(ARBITER_SOFT_START_MS * 2));
+#endif
+}
+
+static void test_arbiter_soft_start()
+{
+  resetPumps();
+  setPower(0, 100);
+  TEST_ASSERT_EQUAL_UINT8(0, arbiterDuty(&pumps[0], 0));
+
+  pumps[0].start(1000, 50);
+  TEST_ASSERT_EQUAL_UINT8(0, arbiterDuty(&pumps[0], 1000));
+  TEST_ASSERT_UINT8_WITHIN(1, 255 / 2, arbiterDuty(&pumps[0], 1000 + ARBITER_SOFT_START_MS / 2));
+  TEST_ASSERT_EQUAL_UINT8(255, arbiterDuty(&pumps[0], 1000 + ARBITER_SOFT_START_MS));
+  TEST_ASSERT_EQUAL_UINT8(255, arbiterDuty(&pumps[0], 1000 + ARBITER_SOFT_START_MS * 30));
+
+  // Ramps to the pump power, not to full duty
+  setPower(0, 40);
+  TEST_ASSERT_EQUAL_UINT8(102, arbiterDuty(&pumps[0], 1000 + ARBITER_SOFT_START_MS));
+  TEST_ASSERT_EQUAL_UINT8(51, arbiterDuty(&pumps[0], 1000 + ARBITER_SOFT_START_MS / 2));
+
+  // Across the millis() roll over
+  pumps[0].start(0xFFFFFFFF - ARBITER_SOFT_START_MS / 2, 50);
+  TEST_ASSERT_EQUAL_UINT8(51, arbiterDuty(&pumps[0], 0));
+}
+
+static void test_arbiter_waits_for_the_ramp()
+{
+  resetPumps();
+  arbiterRequest(&arbiter, 0);
+
+  // While another one is ramping nothing starts, whatever the budget
+  pumps[3].start(20000, 50);
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_NONE, admit(20000));
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_NONE, admit(20000 + ARBITER_SOFT_START_MS - 1));
+  TEST_ASSERT_TRUE(arbiterIsQueued(&arbiter, 0));
+  pumps[3].stop(20000 + ARBITER_SOFT_START_MS - 1); // e.g. a leak
+  TEST_ASSERT_EQUAL_UINT8(0, admit(20000 + ARBITER_SOFT_START_MS - 1));
+}
+
+static void test_arbiter_drops_pumps_started_meanwhile()
+{
+  resetPumps();
+  arbiterRequest(&arbiter, 2);
+  arbiterRequest(&arbiter, 1);
+  pumps[2].start(0, 50); // e.g. COMMAND_START_PUMP
+  TEST_ASSERT_EQUAL_UINT8(ARBITER_NONE, arbiterNext(&arbiter, pumps, TEST_PUMPS, ARBITER_SOFT_START_MS * 2));
+  TEST_ASSERT_EQUAL_UINT8(0x02, arbiterQueuedMask(&arbiter));
+}
+
+void runPumpArbiterTests()
+{
+  RUN_TEST(test_arbiter_queue);
+  RUN_TEST(test_arbiter_fifo_order);
+  RUN_TEST(test_arbiter_max_pumps);
+  RUN_TEST(test_arbiter_power_budget);
+  RUN_TEST(test_arbiter_soft_start);
+  RUN_TEST(test_arbiter_waits_for_the_ramp);
+  RUN_TEST(test_arbiter_drops_pumps_started_meanwhile);
+}
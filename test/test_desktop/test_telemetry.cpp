@@ -0,0 +1,85 @@
+#include <unity.h>
+
+#include "fault_log.h"
+#include "host_tool.h"
+#include "telemetry.h"
+
+// Python has to start and open the pty first
+#define TOOL_START_MS 5000
+#define LINE_TIMEOUT_MS 100
+
+static const SensorData sensorData = {-5, 40, 70, {10, 0, 100}};
+
+/**
+ * Send SensorData until the decoder prints it: frames sent before the tool opens
+ * the pty can be flushed by pyserial. Then skips the copies of that line.
+ */
+static void sendSensorData(HostTool *tool, const char *expected)
+{
+  char line[256];
+  bool decoded = false;
+  for (uint16_t i = 0; i < TOOL_START_MS / LINE_TIMEOUT_MS && !decoded; i++)
+  {
+    telemetrySensorData(1234, sensorData, 0x05);
+    decoded = hostToolReadLine(tool, line, sizeof(line), LINE_TIMEOUT_MS);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(decoded, "no output from telemetry_decode.py");
+  TEST_ASSERT_EQUAL_STRING(expected, line);
+}
+
+/**
+ * Next line that isn't a repeated SensorData one.
+ */
+static void readAfter(HostTool *tool, const char *repeated, char *line, size_t size)
+{
+  do
+  {
+    TEST_ASSERT_TRUE(hostToolReadLine(tool, line, size, TOOL_START_MS));
+  } while (strcmp(line, repeated) == 0);
+}
+
+static void test_decoder_json()
+{
+  const char *args[] = {"--json", NULL};
+  const char *sensorLine = "{\"type\": \"sensor\", \"uptime_ms\": 1234, \"temperature\": -5, \"humidity\": 40, "
+                           "\"light\": 70, \"soil\": [10, 0, 100], \"running\": 5}";
+  char line[256];
+  HostTool tool;
+  TEST_ASSERT_TRUE(hostToolStart(&tool, "telemetry_decode.py", args));
+
+  sendSensorData(&tool, sensorLine);
+  telemetryPumpEvent(5000, 2, true, 0);
+  readAfter(&tool, sensorLine, line, sizeof(line));
+  TEST_ASSERT_EQUAL_STRING("{\"type\": \"pump\", \"uptime_ms\": 5000, \"pump\": 2, \"running\": true, \"ml\": 0}", line);
+  telemetryPumpEvent(0x12345678, 0, false, 480);
+  TEST_ASSERT_TRUE(hostToolReadLine(&tool, line, sizeof(line), TOOL_START_MS));
+  TEST_ASSERT_EQUAL_STRING("{\"type\": \"pump\", \"uptime_ms\": 305419896, \"pump\": 0, \"running\": false, \"ml\": 480}", line);
+
+  hostToolStop(&tool);
+}
+
+static void test_decoder_csv()
+{
+  const char *sensorLine = "sensor,1234,-5,40,70,10,0,100,5,,,";
+  char line[256];
+  HostTool tool;
+  TEST_ASSERT_TRUE(hostToolStart(&tool, "telemetry_decode.py", NULL));
+
+  TEST_ASSERT_TRUE(hostToolReadLine(&tool, line, sizeof(line), TOOL_START_MS));
+  TEST_ASSERT_EQUAL_STRING("type,uptime_ms,temperature,humidity,light,soil1,soil2,soil3,running,pump,ml,code", line);
+  sendSensorData(&tool, sensorLine);
+  telemetryPumpEvent(5000, 2, false, 480);
+  readAfter(&tool, sensorLine, line, sizeof(line));
+  TEST_ASSERT_EQUAL_STRING("pump,5000,,,,,,,False,2,480,", line);
+  telemetryFault(7000, FAULT_LEAK, 0x03);
+  TEST_ASSERT_TRUE(hostToolReadLine(&tool, line, sizeof(line), TOOL_START_MS));
+  TEST_ASSERT_EQUAL_STRING("fault,7000,,,,,,,3,,,leak", line);
+
+  hostToolStop(&tool);
+}
+
+void runTelemetryTests()
+{
+  RUN_TEST(test_decoder_json);
+  RUN_TEST(test_decoder_csv);
+}
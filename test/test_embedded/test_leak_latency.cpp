@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "leak_guard.h"
+#include "soft_pwm.h"
+
+// Same wiring as main.cpp: probe on D10 (PB2 PCINT2), a hardware PWM pump and a software one
+#define PROBE_PIN 10
+#define PWM_PUMP_PIN 6
+#define SOFT_PWM_PUMP_PIN 7
+
+// From the probe edge to the outputs cut, at 16 MHz: 20 us
+#define LEAK_MAX_CYCLES 320
+
+LeakGuard leakGuard;
+// TCNT1 when the ISR is done cutting, 0 until then
+volatile uint16_t cutAtCycles = 0;
+
+// As in main.cpp, plus the time stamp
+ISR(PCINT0_vect)
+{
+  leakGuardCheck(&leakGuard);
+  if (cutAtCycles == 0)
+  {
+    cutAtCycles = TCNT1;
+  }
+}
+
+static void addOutput(uint8_t pin, volatile uint8_t *tccr, uint8_t comMask)
+{
+  leakGuardAddOutput(&leakGuard, portOutputRegister(digitalPinToPort(pin)), digitalPinToBitMask(pin), tccr, comMask);
+}
+
+void setUp()
+{
+  // Dry probe, both pumps running at half power
+  pinMode(PROBE_PIN, INPUT_PULLUP);
+  leakGuardBegin(&leakGuard, portInputRegister(digitalPinToPort(PROBE_PIN)), digitalPinToBitMask(PROBE_PIN));
+  addOutput(PWM_PUMP_PIN, &TCCR0A, _BV(COM0A1));
+  addOutput(SOFT_PWM_PUMP_PIN, &TIMSK2, _BV(TOIE2));
+  pinMode(PWM_PUMP_PIN, OUTPUT);
+  analogWrite(PWM_PUMP_PIN, 128);
+  // Through 0, the previous test left it cut at 128
+  softPwmWrite(SOFT_PWM_PUMP_PIN, 0);
+  softPwmWrite(SOFT_PWM_PUMP_PIN, 128);
+
+  // Timer1 counts CPU cycles
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  PCICR |= _BV(PCIE0);
+  PCMSK0 |= _BV(PCINT2);
+}
+
+void tearDown()
+{
+  PCMSK0 &= ~_BV(PCINT2);
+}
+
+/**
+ * Drive the probe pin low ourselves: a pin change interrupt fires on an output too.
+ * Returns the cycles from the edge to the end of the ISR.
+ */
+static uint16_t wetProbe()
+{
+  cutAtCycles = 0;
+  PORTB |= _BV(PB2);
+  DDRB |= _BV(PB2);
+  PCIFR = _BV(PCIF0);
+  uint16_t edgeAtCycles = TCNT1;
+  PORTB &= ~_BV(PB2);
+  while (cutAtCycles == 0)
+    ;
+  return cutAtCycles - edgeAtCycles;
+}
+
+static void dryProbe()
+{
+  DDRB &= ~_BV(PB2);
+  PORTB |= _BV(PB2);
+}
+
+static void test_leak_cuts_within_budget()
+{
+  char message[48];
+  uint16_t cycles = wetProbe();
+  snprintf(message, sizeof(message), "leak reaction: %u cycles, %u us", cycles, (unsigned)(cycles / (F_CPU / 1000000ul)));
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_TRUE(leakGuard.tripped);
+  TEST_ASSERT_LESS_THAN_UINT16(LEAK_MAX_CYCLES, cycles);
+  dryProbe();
+}
+
+static void test_leak_outputs_stay_low()
+{
+  wetProbe();
+  // A few PWM periods: neither timer may set the pins again
+  delay(10);
+  TEST_ASSERT_EQUAL_UINT8(0, TCCR0A & _BV(COM0A1));
+  TEST_ASSERT_EQUAL_UINT8(0, TIMSK2 & _BV(TOIE2));
+  TEST_ASSERT_EQUAL(LOW, digitalRead(PWM_PUMP_PIN));
+  TEST_ASSERT_EQUAL(LOW, digitalRead(SOFT_PWM_PUMP_PIN));
+
+  // Latched while wet, cleared once dry
+  TEST_ASSERT_FALSE(leakGuardAcknowledge(&leakGuard));
+  dryProbe();
+  TEST_ASSERT_TRUE(leakGuardAcknowledge(&leakGuard));
+}
+
+void setup()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_leak_cuts_within_budget);
+  RUN_TEST(test_leak_outputs_stay_low);
+  UNITY_END();
+}
+
+void loop()
+{
+}
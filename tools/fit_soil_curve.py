@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Fit a soil probe curve from raw readings with a reference moisture.
+
+    tools/plant_cli.py /dev/ttyUSB0 capture 0 35 --out points.csv   # once per point, e.g. weighing the pot
+    tools/fit_soil_curve.py points.csv --pump 0 > curve.json
+    tools/plant_cli.py /dev/ttyUSB0 set-curve 0 curve.json
+
+The points are averaged per raw value, made monotonic (pool adjacent violators) and
+sampled at the knots of include/soil_curve.h. Outside the captured range the curve is flat.
+"""
+
+import argparse
+import csv
+import json
+import sys
+
+import plantlink
+
+
+def load_points(paths, pump):
+    points = {}
+    for path in paths:
+        with open(path, newline="") as f:
+            for row in csv.DictReader(f):
+                if pump is not None and int(row.get("pump", pump)) != pump:
+                    continue
+                points.setdefault(int(row["raw"]), []).append(float(row["moisture"]))
+    return sorted((raw, sum(values) / len(values), len(values)) for raw, values in points.items())
+
+
+def monotonic(points, rising):
+    """Closest monotonic sequence in the least squares sense, weighted by the number of readings."""
+    blocks = []  # [mean, weight, count of raw values]
+    for _, value, weight in points:
+        blocks.append([value if rising else -value, weight, 1])
+        while len(blocks) > 1 and blocks[-2][0] > blocks[-1][0]:
+            mean, weight, count = blocks.pop()
+            last = blocks[-1]
+            last[0] = (last[0] * last[1] + mean * weight) / (last[1] + weight)
+            last[1] += weight
+            last[2] += count
+    values = []
+    for mean, _, count in blocks:
+        values += [mean if rising else -mean] * count
+    return values
+
+
+def interpolate(xs, ys, x):
+    if x <= xs[0]:
+        return ys[0]
+    if x >= xs[-1]:
+        return ys[-1]
+    for i in range(1, len(xs)):
+        if x <= xs[i]:
+            return ys[i - 1] + (ys[i] - ys[i - 1]) * (x - xs[i - 1]) / (xs[i] - xs[i - 1])
+
+
+def fit(points):
+    xs = [raw for raw, _, _ in points]
+    mean_x = sum(xs) / len(xs)
+    mean_y = sum(value for _, value, _ in points) / len(points)
+    rising = sum((raw - mean_x) * (value - mean_y) for raw, value, _ in points) >= 0
+    ys = monotonic(points, rising)
+    return [max(0, min(100, round(interpolate(xs, ys, i << plantlink.SOIL_CURVE_SHIFT))))
+            for i in range(plantlink.SOIL_CURVE_KNOTS)]
+
+
+def evaluate(knots, raw):
+    """Same as soilCurveEval() in src/soil_curve.cpp."""
+    raw = min(raw, 1023)
+    segment = raw >> plantlink.SOIL_CURVE_SHIFT
+    fraction = raw & ((1 << plantlink.SOIL_CURVE_SHIFT) - 1)
+    delta = knots[segment + 1] - knots[segment]
+    return knots[segment] + ((delta * fraction + (1 << (plantlink.SOIL_CURVE_SHIFT - 1))) >> plantlink.SOIL_CURVE_SHIFT)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("points", nargs="+", help="CSV with raw and moisture columns (and pump)")
+    parser.add_argument("--pump", type=int, help="only the points of this probe")
+    args = parser.parse_args()
+
+    points = load_points(args.points, args.pump)
+    if len(points) < 2:
+        sys.exit("need at least 2 different raw readings")
+    knots = fit(points)
+    error = max(abs(evaluate(knots, raw) - value) for raw, value, _ in points)
+    print("%d points, max error %.1f%%" % (len(points), error), file=sys.stderr)
+    print(json.dumps({"knots": knots}))
+
+
+if __name__ == "__main__":
+    main()
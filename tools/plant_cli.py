@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""Configure and control a unit through its serial port.
+
+    tools/plant_cli.py /dev/ttyUSB0 get-config > unit.json
+    tools/plant_cli.py /dev/ttyUSB0 push-config unit.json
+    tools/plant_cli.py /dev/ttyUSB0 start 1
+    tools/plant_cli.py /dev/ttyUSB0 calibrate dry 0
+    tools/plant_cli.py /dev/ttyUSB0 calibrate flow 0 --ml 250
+    tools/plant_cli.py /dev/ttyUSB0 capture 0 35 --out points.csv
+    tools/plant_cli.py /dev/ttyUSB0 set-curve 0 curve.json
+"""
+
+import argparse
+import csv
+import json
+import os
+import struct
+import sys
+
+import plantlink
+
+CHUNK = 24
+
+
+def check(status, what):
+    if status != 0:
+        sys.exit("%s failed: %s" % (what, plantlink.STATUS.get(status, status)))
+
+
+def get_config(link):
+    data = b""
+    while len(data) < plantlink.config_size():
+        status, chunk = link.request(plantlink.READ_CONFIG, bytes([len(data), CHUNK]))
+        check(status, "read config")
+        data += chunk
+    return plantlink.unpack_config(data)
+
+
+def push_config(link, config):
+    """Stage the whole image, then commit it in one go: the unit validates it before saving."""
+    data = plantlink.pack_config(config)
+    for offset in range(0, len(data), CHUNK):
+        status, _ = link.request(plantlink.WRITE_CONFIG, bytes([offset]) + data[offset:offset + CHUNK])
+        check(status, "write config")
+    status, _ = link.request(plantlink.COMMIT_CONFIG, struct.pack("<H", plantlink.crc16(data)))
+    check(status, "commit config")
+
+
+def get_state(link):
+    status, data = link.request(plantlink.GET_STATE)
+    check(status, "get state")
+    uptime, mask, temp, humid, light, s1, s2, s3 = struct.unpack("<IBbBBBBB", data[:11])
+    end = 11 + 2 * plantlink.NUM_PUMPS
+    next_runs = struct.unpack("<%dH" % plantlink.NUM_PUMPS, data[11:end])
+    return {"uptime_ms": uptime, "running": [bool(mask & (1 << i)) for i in range(plantlink.NUM_PUMPS)],
+            "temperature": temp, "humidity": humid, "light": light, "soil": [s1, s2, s3],
+            "seconds_to_next_run": list(next_runs), "fault": bool(data[end]) if len(data) > end else False,
+            # Warm restart builds only
+            "reset_flags": [name for bit, name in enumerate(plantlink.RESET_FLAGS) if data[end + 1] & (1 << bit)]
+            if len(data) > end + 1 else None,
+            "warm_boot": bool(data[end + 2]) if len(data) > end + 2 else None}
+
+
+def get_faults(link):
+    status, data = link.request(plantlink.READ_FAULTS)
+    check(status, "read faults")
+    # Must match include/fault_log.h
+    _, total, next_record = struct.unpack("<BBB", data[:3])
+    records = [struct.unpack("<IBB", data[3 + 6 * i:9 + 6 * i]) for i in range(4)]
+    # Oldest first, skipping the empty slots
+    records = records[next_record:] + records[:next_record]
+    return {"total": total, "faults": [{"uptime_ms": uptime, "code": plantlink.FAULTS.get(code, code),
+                                        "running": mask} for uptime, code, mask in records if code]}
+
+
+def get_doses(link):
+    doses = []
+    count = 1
+    while len(doses) < count:
+        status, data = link.request(plantlink.READ_DOSES, bytes([len(doses)]))
+        check(status, "read doses")
+        count = data[0]
+        if len(data) > 1:
+            # Must match include/dose_log.h
+            uptime, seconds, ml, pump = struct.unpack("<IHHB", data[1:10])
+            doses.append({"uptime_ms": uptime, "pump": pump, "seconds": seconds, "ml": ml})
+    return doses
+
+
+def capture(link, pump, moisture, path):
+    """Append the raw reading of the probe and the reference moisture to a CSV, for fit_soil_curve.py."""
+    status, data = link.request(plantlink.CALIBRATE, bytes([plantlink.CALIBRATE_TARGETS["raw"], pump]))
+    check(status, "read probe")
+    raw = struct.unpack("<H", data)[0]
+    new = not os.path.exists(path)
+    with open(path, "a", newline="") as f:
+        writer = csv.writer(f)
+        if new:
+            writer.writerow(("pump", "raw", "moisture"))
+        writer.writerow((pump, raw, moisture))
+    return raw
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port or pty")
+    parser.add_argument("--baud", type=int, default=plantlink.BAUD)
+    commands = parser.add_subparsers(dest="command", required=True)
+    commands.add_parser("get-config")
+    push = commands.add_parser("push-config")
+    push.add_argument("file")
+    commands.add_parser("state")
+    for name in ("start", "stop"):
+        commands.add_parser(name).add_argument("pump", type=int, help="0 based pump index")
+    calibrate = commands.add_parser("calibrate")
+    calibrate.add_argument("target", choices=sorted(plantlink.CALIBRATE_TARGETS))
+    calibrate.add_argument("pump", type=int, nargs="?", default=0)
+    calibrate.add_argument("--ml", type=int, help="flow: water measured for the last run of the pump")
+    commands.add_parser("save")
+    commands.add_parser("faults")
+    commands.add_parser("doses", help="water delivered by the last runs, oldest first")
+    capture_cmd = commands.add_parser("capture")
+    capture_cmd.add_argument("pump", type=int)
+    capture_cmd.add_argument("moisture", type=float, help="reference moisture of the pot, in %%")
+    capture_cmd.add_argument("--out", default="soil_points.csv")
+    commands.add_parser("get-curve").add_argument("pump", type=int)
+    set_curve = commands.add_parser("set-curve")
+    set_curve.add_argument("pump", type=int)
+    set_curve.add_argument("file", help="JSON written by fit_soil_curve.py")
+    commands.add_parser("ack")
+    args = parser.parse_args()
+
+    link = plantlink.Link(args.port, args.baud)
+    if args.command == "get-config":
+        print(json.dumps(get_config(link), indent=2))
+    elif args.command == "push-config":
+        with open(args.file) as f:
+            push_config(link, json.load(f))
+    elif args.command == "state":
+        print(json.dumps(get_state(link), indent=2))
+    elif args.command in ("start", "stop"):
+        command = plantlink.START_PUMP if args.command == "start" else plantlink.STOP_PUMP
+        check(link.request(command, bytes([args.pump]))[0], args.command)
+    elif args.command == "calibrate":
+        payload = bytes([plantlink.CALIBRATE_TARGETS[args.target], args.pump])
+        if args.target == "flow":
+            if args.ml is None:
+                parser.error("calibrate flow needs --ml")
+            payload += struct.pack("<H", args.ml)
+        status, data = link.request(plantlink.CALIBRATE, payload)
+        check(status, "calibrate")
+        print(struct.unpack("<H", data)[0])
+    elif args.command == "save":
+        check(link.request(plantlink.SAVE_CONFIG)[0], "save")
+    elif args.command == "faults":
+        print(json.dumps(get_faults(link), indent=2))
+    elif args.command == "doses":
+        print(json.dumps(get_doses(link), indent=2))
+    elif args.command == "ack":
+        check(link.request(plantlink.ACK_FAULT)[0], "acknowledge fault")
+    elif args.command == "capture":
+        print(capture(link, args.pump, args.moisture, args.out))
+    elif args.command == "get-curve":
+        status, data = link.request(plantlink.GET_CURVE, bytes([args.pump]))
+        check(status, "get curve")
+        print(json.dumps({"knots": list(data)}))
+    elif args.command == "set-curve":
+        with open(args.file) as f:
+            knots = json.load(f)["knots"]
+        if len(knots) != plantlink.SOIL_CURVE_KNOTS:
+            sys.exit("a curve has %d knots" % plantlink.SOIL_CURVE_KNOTS)
+        check(link.request(plantlink.SET_CURVE, bytes([args.pump] + knots))[0], "set curve")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,268 @@
+"""Framing shared with the firmware (src/telemetry.cpp).
+
+Every frame is [type][seq][payload...][crc16 lo][crc16 hi], COBS encoded and
+terminated by a 0x00 delimiter. CRC is CRC-16/CCITT-FALSE.
+"""
+
+import os
+import struct
+import sys
+import time
+
+SENSOR_DATA = 0x01
+PUMP_EVENT = 0x02
+PUMP_CONFIG = 0x03
+SENSOR_CONFIG = 0x04
+NODE_STATUS = 0x05
+FAULT = 0x06
+
+READ_CONFIG = 0x10
+WRITE_CONFIG = 0x11
+COMMIT_CONFIG = 0x12
+START_PUMP = 0x13
+STOP_PUMP = 0x14
+CALIBRATE = 0x15
+GET_STATE = 0x16
+SAVE_CONFIG = 0x17
+ACK_FAULT = 0x18
+READ_FAULTS = 0x19
+READ_DOSES = 0x1A
+GET_CURVE = 0x1B
+SET_CURVE = 0x1C
+COMMAND_REPLY = 0x20
+
+STATUS = {0: "ok", 1: "bad request", 2: "invalid config", 3: "crc mismatch", 4: "fault still active"}
+FAULTS = {1: "leak"}
+# MCUSR bits, in GET_STATE
+RESET_FLAGS = ["power on", "external", "brown-out", "watchdog"]
+CALIBRATE_TARGETS = {"dry": 0, "wet": 1, "day": 2, "night": 3, "flow": 4, "raw": 5}
+
+NUM_PUMPS = 3
+
+# Must match include/soil_curve.h: knots at raw 0, 64, ... 1024
+SOIL_CURVE_SHIFT = 6
+SOIL_CURVE_KNOTS = (1024 >> SOIL_CURVE_SHIFT) + 1
+
+BAUD = 38400
+
+# Must match include/eeprom_mem.h, include/pump_config.h and include/sensor_config.h
+EEPROM_MEM_MAGIC = 0x5A
+EEPROM_MEM_VERSION = 2
+EEPROM_MEM_HEADER_FORMAT = "<BB"
+PUMP_CONFIG_FIELDS = ("frequency", "secondsPump", "power", "soilSensor", "lightSensor", "mode", "doseGain",
+                      "doseMl", "flowUlPerPulse")
+PUMP_CONFIG_FORMAT = "<hhhBBBBHH"
+SENSOR_CONFIG_FORMAT = "<hh3h3h"
+
+
+def pack_config(config):
+    """dict (as written by unpack_config) -> EEPROM_MEM image."""
+    data = struct.pack(EEPROM_MEM_HEADER_FORMAT, EEPROM_MEM_MAGIC, EEPROM_MEM_VERSION)
+    for pump in config["pumps"]:
+        data += struct.pack(PUMP_CONFIG_FORMAT, *(pump[f] for f in PUMP_CONFIG_FIELDS))
+    sensor = config["sensor"]
+    data += struct.pack(SENSOR_CONFIG_FORMAT, sensor["lightSensorDayValue"], sensor["lightSensorNightValue"],
+                        *(sensor["soilSensorDryValue"] + sensor["soilSensorWetValue"]))
+    return data
+
+
+def unpack_config(data):
+    """EEPROM_MEM image -> dict."""
+    header = struct.calcsize(EEPROM_MEM_HEADER_FORMAT)
+    magic, version = struct.unpack(EEPROM_MEM_HEADER_FORMAT, data[:header])
+    if magic != EEPROM_MEM_MAGIC or version != EEPROM_MEM_VERSION:
+        raise ValueError("config layout %d of the unit, this tool knows %d" % (version, EEPROM_MEM_VERSION))
+    data = data[header:]
+    size = struct.calcsize(PUMP_CONFIG_FORMAT)
+    pumps = []
+    for i in range(NUM_PUMPS):
+        values = struct.unpack(PUMP_CONFIG_FORMAT, data[i * size:(i + 1) * size])
+        pumps.append(dict(zip(PUMP_CONFIG_FIELDS, values)))
+    values = struct.unpack(SENSOR_CONFIG_FORMAT, data[NUM_PUMPS * size:])
+    return {"pumps": pumps,
+            "sensor": {"lightSensorDayValue": values[0], "lightSensorNightValue": values[1],
+                       "soilSensorDryValue": list(values[2:5]), "soilSensorWetValue": list(values[5:8])}}
+
+
+def config_size():
+    return (struct.calcsize(EEPROM_MEM_HEADER_FORMAT) + NUM_PUMPS * struct.calcsize(PUMP_CONFIG_FORMAT) +
+            struct.calcsize(SENSOR_CONFIG_FORMAT))
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_idx = 0
+    for i, byte in enumerate(data):
+        if byte == 0:
+            out[code_idx] = len(out) - code_idx
+            code_idx = len(out)
+            out.append(0)
+        else:
+            out.append(byte)
+            # Blocks hold at most 254 bytes
+            if len(out) - code_idx == 0xFF and i + 1 < len(data):
+                out[code_idx] = 0xFF
+                code_idx = len(out)
+                out.append(0)
+    out[code_idx] = len(out) - code_idx
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("bad COBS code")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(frame_type, seq, payload):
+    frame = bytes([frame_type, seq & 0xFF]) + payload
+    return cobs_encode(frame + struct.pack("<H", crc16(frame))) + b"\x00"
+
+
+def decode_frame(raw):
+    """Returns (type, seq, payload) or None if the frame is corrupted."""
+    try:
+        frame = cobs_decode(raw)
+    except ValueError:
+        return None
+    if len(frame) < 4:
+        return None
+    body, (crc,) = frame[:-2], struct.unpack("<H", frame[-2:])
+    if crc16(body) != crc:
+        return None
+    return body[0], body[1], body[2:]
+
+
+def parse(frame_type, payload):
+    """Turn a frame payload into a dict, None for unknown frames."""
+    if frame_type == SENSOR_DATA:
+        uptime, temp, humid, light, s1, s2, s3, mask = struct.unpack("<IbBBBBBB", payload)
+        return {"type": "sensor", "uptime_ms": uptime, "temperature": temp, "humidity": humid,
+                "light": light, "soil": [s1, s2, s3], "running": mask}
+    if frame_type == PUMP_EVENT:
+        # Older firmware doesn't send the measured ml
+        uptime, pump, running, ml = struct.unpack("<IBBH", payload.ljust(8, b"\0"))
+        return {"type": "pump", "uptime_ms": uptime, "pump": pump, "running": bool(running), "ml": ml}
+    if frame_type == PUMP_CONFIG:
+        values = struct.unpack(PUMP_CONFIG_FORMAT, payload[1:])
+        config = dict(zip(PUMP_CONFIG_FIELDS, values))
+        config.update({"type": "pump_config", "pump": payload[0]})
+        return config
+    if frame_type == SENSOR_CONFIG:
+        values = struct.unpack(SENSOR_CONFIG_FORMAT, payload)
+        return {"type": "sensor_config", "lightSensorDayValue": values[0],
+                "lightSensorNightValue": values[1], "soilSensorDryValue": list(values[2:5]),
+                "soilSensorWetValue": list(values[5:8])}
+    if frame_type == FAULT:
+        uptime, code, mask = struct.unpack("<IBB", payload)
+        return {"type": "fault", "uptime_ms": uptime, "code": FAULTS.get(code, code), "running": mask}
+    if frame_type == NODE_STATUS:
+        # Status registers of a node, see include/node.h
+        (node, version, running, due, hold, command, arg, status,
+         temp, humid, light, s1, s2, s3) = struct.unpack("<BBBBBBBBbBBBBB", payload)
+        return {"type": "node", "node": node, "version": version, "running": running, "due": due,
+                "hold": bool(hold), "command": command, "commandStatus": status,
+                "temperature": temp, "humidity": humid, "light": light, "soil": [s1, s2, s3]}
+    return None
+
+
+class TtyStream:
+    """Raw POSIX tty (serial adapter or pty), for when pyserial is not installed."""
+
+    def __init__(self, path, baud, timeout):
+        import termios
+        import tty
+        self.name = path
+        self.timeout = timeout
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[4] = attrs[5] = getattr(termios, "B%d" % baud)
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+
+    def read(self, size):
+        import select
+        if not select.select([self.fd], [], [], self.timeout)[0]:
+            return b""
+        return os.read(self.fd, size)
+
+    def write(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+
+class Link:
+    """Splits a byte stream (serial port, pty or capture file) into frames."""
+
+    def __init__(self, path, baud=BAUD):
+        self.is_file = os.path.isfile(path) or path == "-"
+        if self.is_file:
+            self.stream = sys.stdin.buffer if path == "-" else open(path, "rb")
+        else:
+            try:
+                import serial
+            except ImportError:
+                self.stream = TtyStream(path, baud, timeout=0.1)
+            else:
+                self.stream = serial.Serial(path, baud, timeout=0.1)
+        self.buffer = bytearray()
+        self.dropped = 0
+        self.seq = 0
+
+    def read_frame(self, timeout=None):
+        """Returns the next valid (type, seq, payload), None on timeout or end of stream."""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while True:
+            while b"\x00" in self.buffer:
+                raw, _, rest = self.buffer.partition(b"\x00")
+                self.buffer = bytearray(rest)
+                if not raw:
+                    continue
+                frame = decode_frame(bytes(raw))
+                if frame is None:
+                    self.dropped += 1
+                    continue
+                return frame
+            chunk = self.stream.read(64)
+            if not chunk and self.is_file:
+                return None
+            if deadline is not None and time.monotonic() > deadline:
+                return None
+            self.buffer += chunk
+
+    def frames(self):
+        """Yields (type, seq, payload), until the stream ends."""
+        while True:
+            frame = self.read_frame()
+            if frame is None:
+                return
+            yield frame
+
+    def request(self, command, payload=b"", timeout=0.5, retries=5):
+        """Send a command and wait for its reply. Returns (status, data)."""
+        for _ in range(retries):
+            self.stream.write(encode_frame(command, self.seq, payload))
+            self.seq += 1
+            deadline = time.monotonic() + timeout
+            while time.monotonic() < deadline:
+                frame = self.read_frame(deadline - time.monotonic())
+                if frame and frame[0] == COMMAND_REPLY and frame[2][0] == command:
+                    return frame[2][1], frame[2][2:]
+        raise TimeoutError("no reply to command 0x%02x" % command)
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream from the controller into CSV or JSON lines.
+
+    tools/telemetry_decode.py /dev/ttyUSB0 --csv > log.csv
+    tools/telemetry_decode.py capture.bin --json
+"""
+
+import argparse
+import csv
+import json
+import sys
+
+import plantlink
+
+CSV_FIELDS = ("type", "uptime_ms", "temperature", "humidity", "light",
+              "soil1", "soil2", "soil3", "running", "pump", "ml", "code")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port, pty, capture file or - for stdin")
+    parser.add_argument("--baud", type=int, default=plantlink.BAUD)
+    parser.add_argument("--json", action="store_true", help="JSON lines instead of CSV")
+    args = parser.parse_args()
+
+    link = plantlink.Link(args.port, args.baud)
+    writer = None
+    if not args.json:
+        writer = csv.DictWriter(sys.stdout, CSV_FIELDS, extrasaction="ignore")
+        writer.writeheader()
+
+    last_seq = None
+    lost = 0
+    for frame_type, seq, payload in link.frames():
+        if last_seq is not None:
+            lost += (seq - last_seq - 1) & 0xFF
+        last_seq = seq
+        message = plantlink.parse(frame_type, payload)
+        if message is None:
+            continue
+        if args.json:
+            print(json.dumps(message), flush=True)
+        elif message["type"] in ("sensor", "pump", "fault"):
+            if "soil" in message:
+                message.update(zip(("soil1", "soil2", "soil3"), message.pop("soil")))
+            writer.writerow(message)
+            sys.stdout.flush()
+
+    print("frames lost: %d, corrupted: %d" % (lost, link.dropped), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()